@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <codeslayer/codeslayer-utils.h>
+#include "codeslayer-stub.h"
+
+/*
+ * Just enough of the CodeSlayer API for the engine to run without the 
+ * editor, as the benchmarks do. Each project keeps its configuration in a 
+ * folder named after it within the configuration folder given. Documents 
+ * are opened by path alone and never read, since the engine only asks 
+ * them for their path and line. None of the signals the engine listens 
+ * to are ever emitted.
+ */
+
+typedef struct _CodeSlayerPrivate CodeSlayerPrivate;
+
+struct _CodeSlayerPrivate
+{
+  gchar              *config_folder_path;
+  GList              *projects;
+  GHashTable         *documents;
+  CodeSlayerDocument *active_document;
+  guint               selections;
+};
+
+typedef struct _CodeSlayerProjectPrivate CodeSlayerProjectPrivate;
+
+struct _CodeSlayerProjectPrivate
+{
+  gchar *name;
+  gchar *folder_path;
+};
+
+typedef struct _CodeSlayerDocumentPrivate CodeSlayerDocumentPrivate;
+
+struct _CodeSlayerDocumentPrivate
+{
+  gchar *file_path;
+  gint   line_number;
+};
+
+#define CODESLAYER_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), codeslayer_get_type (), CodeSlayerPrivate))
+#define CODESLAYER_PROJECT_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), codeslayer_project_get_type (), CodeSlayerProjectPrivate))
+#define CODESLAYER_DOCUMENT_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), codeslayer_document_get_type (), CodeSlayerDocumentPrivate))
+
+static void codeslayer_finalize           (CodeSlayer         *codeslayer);
+static void codeslayer_project_finalize   (CodeSlayerProject  *project);
+static void codeslayer_document_finalize  (CodeSlayerDocument *document);
+
+G_DEFINE_TYPE (CodeSlayer, codeslayer, G_TYPE_OBJECT)
+G_DEFINE_TYPE (CodeSlayerProject, codeslayer_project, G_TYPE_OBJECT)
+G_DEFINE_TYPE (CodeSlayerDocument, codeslayer_document, G_TYPE_OBJECT)
+
+static void
+codeslayer_class_init (CodeSlayerClass *klass)
+{
+  g_signal_new ("document-saved", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST, 
+                0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT, 
+                G_TYPE_NONE, 1, G_TYPE_OBJECT);
+  g_signal_new ("project-properties-opened", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST, 
+                0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT, 
+                G_TYPE_NONE, 1, G_TYPE_OBJECT);
+  g_signal_new ("project-properties-saved", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST, 
+                0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT, 
+                G_TYPE_NONE, 1, G_TYPE_OBJECT);
+  g_signal_new ("projects-changed", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST, 
+                0, NULL, NULL, g_cclosure_marshal_VOID__POINTER, 
+                G_TYPE_NONE, 1, G_TYPE_POINTER);
+
+  G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) codeslayer_finalize;
+  g_type_class_add_private (klass, sizeof (CodeSlayerPrivate));
+}
+
+static void
+codeslayer_init (CodeSlayer *codeslayer)
+{
+  CodeSlayerPrivate *priv;
+  priv = CODESLAYER_GET_PRIVATE (codeslayer);
+  priv->config_folder_path = NULL;
+  priv->projects = NULL;
+  priv->documents = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  priv->active_document = NULL;
+  priv->selections = 0;
+}
+
+static void
+codeslayer_finalize (CodeSlayer *codeslayer)
+{
+  CodeSlayerPrivate *priv;
+  priv = CODESLAYER_GET_PRIVATE (codeslayer);
+  
+  g_list_foreach (priv->projects, (GFunc) g_object_unref, NULL);
+  g_list_free (priv->projects);
+  g_hash_table_destroy (priv->documents);
+  g_free (priv->config_folder_path);
+  
+  G_OBJECT_CLASS (codeslayer_parent_class)->finalize (G_OBJECT (codeslayer));
+}
+
+static void
+codeslayer_project_class_init (CodeSlayerProjectClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) codeslayer_project_finalize;
+  g_type_class_add_private (klass, sizeof (CodeSlayerProjectPrivate));
+}
+
+static void
+codeslayer_project_init (CodeSlayerProject *project)
+{
+  CodeSlayerProjectPrivate *priv;
+  priv = CODESLAYER_PROJECT_GET_PRIVATE (project);
+  priv->name = NULL;
+  priv->folder_path = NULL;
+}
+
+static void
+codeslayer_project_finalize (CodeSlayerProject *project)
+{
+  CodeSlayerProjectPrivate *priv;
+  priv = CODESLAYER_PROJECT_GET_PRIVATE (project);
+  g_free (priv->name);
+  g_free (priv->folder_path);
+  G_OBJECT_CLASS (codeslayer_project_parent_class)->finalize (G_OBJECT (project));
+}
+
+static void
+codeslayer_document_class_init (CodeSlayerDocumentClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) codeslayer_document_finalize;
+  g_type_class_add_private (klass, sizeof (CodeSlayerDocumentPrivate));
+}
+
+static void
+codeslayer_document_init (CodeSlayerDocument *document)
+{
+  CodeSlayerDocumentPrivate *priv;
+  priv = CODESLAYER_DOCUMENT_GET_PRIVATE (document);
+  priv->file_path = NULL;
+  priv->line_number = 0;
+}
+
+static void
+codeslayer_document_finalize (CodeSlayerDocument *document)
+{
+  CodeSlayerDocumentPrivate *priv;
+  priv = CODESLAYER_DOCUMENT_GET_PRIVATE (document);
+  g_free (priv->file_path);
+  G_OBJECT_CLASS (codeslayer_document_parent_class)->finalize (G_OBJECT (document));
+}
+
+CodeSlayer*
+codeslayer_stub_new (const gchar *config_folder_path)
+{
+  CodeSlayer *codeslayer;
+  codeslayer = g_object_new (codeslayer_get_type (), NULL);
+  CODESLAYER_GET_PRIVATE (codeslayer)->config_folder_path = g_strdup (config_folder_path);
+  return codeslayer;
+}
+
+CodeSlayerProject*
+codeslayer_stub_add_project (CodeSlayer  *codeslayer,
+                             const gchar *name,
+                             const gchar *folder_path)
+{
+  CodeSlayerPrivate *priv;
+  CodeSlayerProjectPrivate *project_priv;
+  CodeSlayerProject *project;
+  
+  priv = CODESLAYER_GET_PRIVATE (codeslayer);
+  
+  project = g_object_new (codeslayer_project_get_type (), NULL);
+  project_priv = CODESLAYER_PROJECT_GET_PRIVATE (project);
+  project_priv->name = g_strdup (name);
+  project_priv->folder_path = g_strdup (folder_path);
+  
+  priv->projects = g_list_append (priv->projects, project);
+  
+  return project;
+}
+
+/*
+ * Makes the document of the file the active one, opening it first if need 
+ * be. The document belongs to the stub.
+ */
+CodeSlayerDocument*
+codeslayer_stub_open_document (CodeSlayer  *codeslayer,
+                               const gchar *file_path,
+                               gint         line_number)
+{
+  CodeSlayerPrivate *priv;
+  CodeSlayerDocument *document;
+  
+  priv = CODESLAYER_GET_PRIVATE (codeslayer);
+  
+  document = g_hash_table_lookup (priv->documents, file_path);
+  if (document == NULL)
+    {
+      document = g_object_new (codeslayer_document_get_type (), NULL);
+      CODESLAYER_DOCUMENT_GET_PRIVATE (document)->file_path = g_strdup (file_path);
+      g_hash_table_insert (priv->documents, g_strdup (file_path), document);
+    }
+  
+  CODESLAYER_DOCUMENT_GET_PRIVATE (document)->line_number = line_number;
+  priv->active_document = document;
+  
+  return document;
+}
+
+/*
+ * Returns how many times the engine has asked for a document to be 
+ * selected.
+ */
+guint
+codeslayer_stub_get_selections (CodeSlayer *codeslayer)
+{
+  return CODESLAYER_GET_PRIVATE (codeslayer)->selections;
+}
+
+CodeSlayerDocument*
+codeslayer_get_active_document (CodeSlayer *codeslayer)
+{
+  return CODESLAYER_GET_PRIVATE (codeslayer)->active_document;
+}
+
+gboolean
+codeslayer_select_document_by_file_path (CodeSlayer  *codeslayer, 
+                                         const gchar *file_path, 
+                                         gint         line_number)
+{
+  CODESLAYER_GET_PRIVATE (codeslayer)->selections++;
+  codeslayer_stub_open_document (codeslayer, file_path, line_number);
+  return TRUE;
+}
+
+GList*
+codeslayer_get_projects (CodeSlayer *codeslayer)
+{
+  return g_list_copy (CODESLAYER_GET_PRIVATE (codeslayer)->projects);
+}
+
+gchar*
+codeslayer_get_project_config_folder_path (CodeSlayer        *codeslayer,
+                                           CodeSlayerProject *project)
+{
+  return g_build_filename (CODESLAYER_GET_PRIVATE (codeslayer)->config_folder_path,
+                           CODESLAYER_PROJECT_GET_PRIVATE (project)->name, NULL);
+}
+
+const gchar*
+codeslayer_project_get_folder_path (CodeSlayerProject *project)
+{
+  return CODESLAYER_PROJECT_GET_PRIVATE (project)->folder_path;
+}
+
+const gchar*
+codeslayer_document_get_file_path (CodeSlayerDocument *document)
+{
+  return CODESLAYER_DOCUMENT_GET_PRIVATE (document)->file_path;
+}
+
+gint
+codeslayer_document_get_line_number (CodeSlayerDocument *document)
+{
+  return CODESLAYER_DOCUMENT_GET_PRIVATE (document)->line_number;
+}
+
+GtkSourceView*
+codeslayer_document_get_source_view (CodeSlayerDocument *document)
+{
+  return NULL;
+}
+
+gboolean
+codeslayer_utils_file_exists (const gchar *file_path)
+{
+  return g_file_test (file_path, G_FILE_TEST_EXISTS);
+}
+
+gchar*
+codeslayer_utils_get_file_path (const gchar *folder_path, 
+                                const gchar *file_name)
+{
+  return g_build_filename (folder_path, file_name, NULL);
+}
+
+GKeyFile*
+codeslayer_utils_get_key_file (const gchar *file_path)
+{
+  GKeyFile *key_file;
+  key_file = g_key_file_new ();
+  g_key_file_load_from_file (key_file, file_path, G_KEY_FILE_NONE, NULL);
+  return key_file;
+}
+
+void
+codeslayer_utils_save_key_file (GKeyFile    *key_file, 
+                                const gchar *file_path)
+{
+  gchar *data;
+  gsize length;
+  
+  data = g_key_file_to_data (key_file, &length, NULL);
+  g_file_set_contents (file_path, data, length, NULL);
+  g_free (data);
+}
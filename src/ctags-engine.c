@@ -16,23 +16,105 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
 #include <codeslayer/codeslayer-utils.h>
 #include "ctags-engine.h"
 #include "ctags-path-node.h"
 #include "ctags-config.h"
 #include "ctags-project-properties.h"
+#include "ctags-store.h"
+#include "ctags-generator.h"
+#include "ctags-watcher.h"
+#include "ctags-stats.h"
+#include "ctags-trace.h"
 #include "readtags.h"
 
 typedef struct
 {
-  gchar         *file_path;
-  unsigned long  line_number;
-} Tag;
+  CtagsEngine  *engine;
+  GtkListStore *store;
+  GtkWidget    *tree;
+} SymbolDialog;
 
+/*
+ * Each project configured for tagging has its own tags file, in its 
+ * config folder next to ctags.conf, and is only tagged again when one of 
+ * its own files changes, whether saved in the editor or changed on disk 
+ * by anything else, as told by a watcher. The matches and file flags of 
+ * a lookup are kept per project since file numbers are only meaningful 
+ * within one file.
+ */
+typedef enum
+{
+  SCHEDULE_IDLE,
+  SCHEDULE_PENDING,
+  SCHEDULE_RUNNING,
+  SCHEDULE_RUNNING_DIRTY
+} ScheduleState;
+
+/*
+ * Warming up opens the tags file of each project, has it read ahead and 
+ * builds the indexes behind completion and symbol search, one step per 
+ * idle at low priority so that input and drawing always go first, which 
+ * makes the first lookup as quick as the later ones. Whether the tags are 
+ * still current is told by the first walk of each watcher, which reports 
+ * the files modified since the tags file was written.
+ */
+typedef enum
+{
+  WARM_UP_OPEN,
+  WARM_UP_NAMES,
+  WARM_UP_SYMBOLS,
+  WARM_UP_STEPS
+} WarmUpStep;
+
+typedef struct
+{
+  CtagsEngine    *engine;
+  gchar          *folder_path;
+  gchar          *source_folder;
+  CtagsStore     *store;
+  CtagsGenerator *generator;
+  CtagsWatcher   *watcher;
+  tagFile        *tag_file;
+  tagMatchSet     matches;
+  GArray         *file_flags;
+  guint           file_flags_generation;
+  gulong          finished_handler_id;
+  gulong          changed_handler_id;
+  guint           event_source_id;
+  ScheduleState   state;
+  gint64          started_time;
+  gint64          update_time;
+  GHashTable     *saved_paths;
+  GHashTable     *running_paths;
+  gboolean        rebuild;
+  gboolean        running_rebuild;
+  gboolean        cancelled;
+  gboolean        warm_up_queued;
+  gboolean        warm_up_indexes;
+} ProjectTags;
+
+typedef struct
+{
+  gchar *name;
+  gint   score;
+} Symbol;
 
 #define MAIN "main"
 #define SOURCE_FOLDER "source_folder"
 #define CTAGS_CONF "ctags.conf"
+#define TAGS "tags"
+#define SYMBOL_RESULTS 50
+
+/* bounds of the delay before tagging, in milliseconds */
+#define MIN_DELAY 250
+#define MAX_DELAY 5000
+
+#define FILE_CLASSIFIED (1 << 0)
+#define FILE_HEADER     (1 << 1)
 
 static void ctags_engine_class_init           (CtagsEngineClass   *klass);
 static void ctags_engine_init                 (CtagsEngine        *engine);
@@ -40,30 +122,98 @@ static void ctags_engine_finalize             (CtagsEngine        *engine);
 
 static CtagsConfig* get_config_by_project     (CtagsEngine        *engine, 
                                                CodeSlayerProject  *project);
+static CtagsConfig* load_config               (CodeSlayerProject  *project,
+                                               const gchar        *folder_path);
+static void watch_config                      (CtagsEngine        *engine,
+                                               const gchar        *folder_path);
+static void config_changed_action             (GFileMonitor       *monitor,
+                                               GFile              *file,
+                                               GFile              *other_file,
+                                               GFileMonitorEvent   event_type,
+                                               CtagsEngine        *engine);
+static void free_config                       (CtagsConfig        *config);
 static void project_properties_opened_action  (CtagsEngine        *engine,
                                                CodeSlayerProject  *project);
 static void project_properties_saved_action   (CtagsEngine        *engine,
                                                CodeSlayerProject  *project);                                                                        
 static void save_config_action                (CtagsEngine        *engine,
                                                CtagsConfig        *config);
+static ProjectTags* get_project_tags          (CtagsEngine        *engine,
+                                               CodeSlayerProject  *project);
+static void sync_project_tags                 (CtagsEngine        *engine);
+static GList* get_search_order                (CtagsEngine        *engine,
+                                               const gchar        *file_path);
+static void remove_project_tags               (ProjectTags        *project_tags);
+static void free_project_tags                 (ProjectTags        *project_tags);
 static void find_tag_action                   (CtagsEngine        *engine);
+static void find_tag_ignore_case_action       (CtagsEngine        *engine);
+static void find_tag                          (CtagsEngine        *engine,
+                                               const int           options);
+static void goto_tag                          (CtagsEngine        *engine,
+                                               CodeSlayerDocument *document,
+                                               const gchar        *name,
+                                               const int           options);
+static gboolean collect_symbol                (const gchar        *name,
+                                               gint                score,
+                                               GArray             *symbols);
+static gint compare_symbols                   (const Symbol       *symbol1,
+                                               const Symbol       *symbol2);
+static gint compare_names                     (const gchar       **name1,
+                                               const gchar       **name2);
+static void find_symbol_action                (CtagsEngine        *engine);
+static void symbol_changed_action             (GtkEntry           *entry,
+                                               SymbolDialog       *symbol_dialog);
+static gboolean add_symbol                    (const gchar        *name,
+                                               gint                score,
+                                               GtkListStore       *store);
+static void symbol_activated_action           (GtkDialog          *dialog);
 static void document_saved_action             (CtagsEngine        *engine, 
                                                CodeSlayerDocument *document);
-static gboolean start_create_tags             (CtagsEngine        *engine);
-static void finish_create_tags                (CtagsEngine        *engine);
-static void execute_create_tags               (CtagsEngine        *engine);
+static void rebuild_tags_action               (CtagsEngine        *engine);
+static void restart_create_tags               (ProjectTags        *project_tags);
+static gboolean start_create_tags             (ProjectTags        *project_tags);
+static gboolean create_tags                   (ProjectTags        *project_tags);
+static gboolean update_tags                   (ProjectTags        *project_tags,
+                                               GHashTable         *saved_paths);
+static void create_tags_finished_action       (ProjectTags        *project_tags,
+                                               gboolean            success);
+static void watch_source_folder               (ProjectTags        *project_tags);
+static void source_changed_action             (ProjectTags        *project_tags);
+static gboolean is_in_folder                  (const gchar        *file_path,
+                                               const gchar        *folder_path);
+static void finish_create_tags                (ProjectTags        *project_tags);
+static void record_run                        (ProjectTags        *project_tags,
+                                               gboolean            success);
+static const gchar* get_run_name              (ProjectTags        *project_tags);
+static void execute_create_tags               (ProjectTags        *project_tags);
+static guint get_delay                        (ProjectTags        *project_tags);
+static void projects_changed_action           (CtagsEngine        *engine);
+static void warm_up_project                   (ProjectTags        *project_tags,
+                                               gboolean            indexes);
+static gboolean warm_up                       (CtagsEngine        *engine);
                                                               
-static GList *find_tags                       (CodeSlayer        *codeslayer, 
+static tagMatchSet *find_tags                  (ProjectTags        *project_tags, 
+                                               tagFile            *tag_file,
                                                const char *const   name, 
                                                const int           options);
-static gboolean search_active_document        (CtagsEngine        *engine, 
-                                               CodeSlayerDocument *document, 
-                                               GList              *tags);
-static gboolean search_projects               (CtagsEngine        *engine, 
-                                               GList              *tags, 
+static void classify_files                    (ProjectTags        *project_tags);
+static gchar* get_selection                   (GtkTextBuffer      *buffer);
+static gboolean open_tags                     (GList              *search_order);
+static void search_tags                       (GList              *search_order,
+                                               const gchar        *name,
+                                               const int           options);
+static gsize count_matches                     (GList              *search_order);
+static const tagMatch* rank_matches           (GList              *search_order,
+                                               CodeSlayerDocument *document);
+static const tagMatch* search_active_document (ProjectTags        *project_tags,
+                                               CodeSlayerDocument *document);
+static const tagMatch* search_projects        (GList              *search_order, 
                                                gboolean            search_headers);
 static void select_document                   (CtagsEngine        *engine, 
-                                               Tag                *tag);                                                              
+                                               const tagMatch     *match);                                                              
+static gboolean select_file                   (CtagsEngine        *engine,
+                                               const gchar        *file_path,
+                                               gint                line_number);
 static void previous_action                   (CtagsEngine        *engine);
 static void next_action                       (CtagsEngine        *engine);
 static void add_path                          (CtagsEngine        *engine,
@@ -72,6 +222,11 @@ static void add_path                          (CtagsEngine        *engine,
                                                const gchar        *to_file_path,
                                                gint                to_line_number);
 static void clear_path                        (CtagsEngine        *engine);
+static void show_statistics_action            (CtagsEngine        *engine);
+static void save_statistics                   (CtagsEngine        *engine,
+                                               GtkWidget          *parent);
+static void trace_action                      (CtagsEngine        *engine,
+                                               gboolean            active);
                                                    
 #define CTAGS_ENGINE_GET_PRIVATE(obj) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((obj), CTAGS_ENGINE_TYPE, CtagsEnginePrivate))
@@ -83,20 +238,47 @@ struct _CtagsEnginePrivate
   CodeSlayer *codeslayer;
   GtkWidget  *menu;
   GtkWidget  *project_properties;
+  GHashTable *project_tags;
+  GHashTable *configs;
+  GHashTable *config_monitors;
+  CtagsStats *stats;
+  guint       generation;
   gulong      properties_opened_id;
   gulong      properties_saved_id;
   gulong      saved_handler_id;
-  guint       event_source_id;
+  gulong      projects_changed_id;
+  GQueue     *warm_up_queue;
+  WarmUpStep  warm_up_step;
+  guint       warm_up_done;
+  guint       warm_up_total;
+  guint       warm_up_source_id;
   GList      *path;
   gint        position;
 };
 
+enum
+{
+  WARM_UP_PROGRESS,
+  LAST_SIGNAL
+};
+
+static guint ctags_engine_signals[LAST_SIGNAL] = { 0 };
+
 G_DEFINE_TYPE (CtagsEngine, ctags_engine, G_TYPE_OBJECT)
 
 static void
 ctags_engine_class_init (CtagsEngineClass *klass)
 {
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  ctags_engine_signals[WARM_UP_PROGRESS] =
+    g_signal_new ("warm-up-progress", 
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (CtagsEngineClass, warm_up_progress),
+                  NULL, NULL, 
+                  g_cclosure_marshal_VOID__DOUBLE, G_TYPE_NONE, 1, G_TYPE_DOUBLE);
+
   gobject_class->finalize = (GObjectFinalizeFunc) ctags_engine_finalize;
   g_type_class_add_private (klass, sizeof (CtagsEnginePrivate));
 }
@@ -107,6 +289,19 @@ ctags_engine_init (CtagsEngine *engine)
   CtagsEnginePrivate *priv;
   priv = CTAGS_ENGINE_GET_PRIVATE (engine);
   priv->path = NULL;
+  priv->generation = 0;
+  priv->stats = ctags_stats_new ();
+  priv->warm_up_queue = g_queue_new ();
+  priv->warm_up_step = WARM_UP_OPEN;
+  priv->warm_up_done = 0;
+  priv->warm_up_total = 0;
+  priv->warm_up_source_id = 0;
+  priv->project_tags = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                              (GDestroyNotify) free_project_tags);
+  priv->configs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify) free_config);
+  priv->config_monitors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                 (GDestroyNotify) g_object_unref);
 }
 
 static void
@@ -119,10 +314,20 @@ ctags_engine_finalize (CtagsEngine *engine)
   
   if (priv->path != NULL)
     g_list_free (priv->path);
+  
+  if (priv->warm_up_source_id != 0)
+    g_source_remove (priv->warm_up_source_id);
+  g_queue_free (priv->warm_up_queue);
+    
+  g_hash_table_destroy (priv->project_tags);
+  g_hash_table_destroy (priv->config_monitors);
+  g_hash_table_destroy (priv->configs);
+  g_object_unref (priv->stats);
     
   g_signal_handler_disconnect (priv->codeslayer, priv->properties_opened_id);
   g_signal_handler_disconnect (priv->codeslayer, priv->properties_saved_id);
   g_signal_handler_disconnect (priv->codeslayer, priv->saved_handler_id);
+  g_signal_handler_disconnect (priv->codeslayer, priv->projects_changed_id);
   
   G_OBJECT_CLASS (ctags_engine_parent_class)->finalize (G_OBJECT(engine));
 }
@@ -141,17 +346,31 @@ ctags_engine_new (CodeSlayer *codeslayer,
   priv->codeslayer = codeslayer;
   priv->menu = menu;
   priv->project_properties = project_properties;
-  priv->event_source_id = 0;
   
   g_signal_connect_swapped (G_OBJECT (menu), "find-tag",
                             G_CALLBACK (find_tag_action), engine);
 
+  g_signal_connect_swapped (G_OBJECT (menu), "find-tag-ignore-case",
+                            G_CALLBACK (find_tag_ignore_case_action), engine);
+
+  g_signal_connect_swapped (G_OBJECT (menu), "find-symbol",
+                            G_CALLBACK (find_symbol_action), engine);
+
+  g_signal_connect_swapped (G_OBJECT (menu), "rebuild-tags",
+                            G_CALLBACK (rebuild_tags_action), engine);
+
   g_signal_connect_swapped (G_OBJECT (menu), "previous", 
                             G_CALLBACK (previous_action), engine);
   
   g_signal_connect_swapped (G_OBJECT (menu), "next", 
                             G_CALLBACK (next_action), engine);
 
+  g_signal_connect_swapped (G_OBJECT (menu), "show-statistics", 
+                            G_CALLBACK (show_statistics_action), engine);
+
+  g_signal_connect_swapped (G_OBJECT (menu), "trace", 
+                            G_CALLBACK (trace_action), engine);
+
   priv->properties_opened_id =  g_signal_connect_swapped (G_OBJECT (codeslayer), "project-properties-opened",
                                                           G_CALLBACK (project_properties_opened_action), engine);
 
@@ -161,31 +380,63 @@ ctags_engine_new (CodeSlayer *codeslayer,
   priv->saved_handler_id = g_signal_connect_swapped (G_OBJECT (codeslayer), "document-saved", 
                                                      G_CALLBACK (document_saved_action), engine);
 
+  priv->projects_changed_id = g_signal_connect_swapped (G_OBJECT (codeslayer), "projects-changed", 
+                                                        G_CALLBACK (projects_changed_action), engine);
+
   g_signal_connect_swapped (G_OBJECT (project_properties), "save-config",
                             G_CALLBACK (save_config_action), engine);
+  
+  sync_project_tags (engine);
 
   return engine;
 }
 
+/*
+ * Returns a new reference to the cached config, or NULL if there is none.
+ */
 static CtagsConfig*
 get_config_by_project (CtagsEngine       *engine, 
                        CodeSlayerProject *project)
 {
   CtagsEnginePrivate *priv;
   CtagsConfig *config;
-  GKeyFile *key_file;
-  gchar *source_folder;
   gchar *folder_path;
-  gchar *file_path;
   
   priv = CTAGS_ENGINE_GET_PRIVATE (engine);
 
   folder_path = codeslayer_get_project_config_folder_path (priv->codeslayer, project);
+  
+  if (g_hash_table_lookup_extended (priv->configs, folder_path, NULL, (gpointer *) &config))
+    {
+      g_free (folder_path);
+      if (config == NULL)
+        return NULL;
+      ctags_config_set_project (config, project);
+      return g_object_ref (config);
+    }
+  
+  watch_config (engine, folder_path);
+  
+  config = load_config (project, folder_path);
+  g_hash_table_insert (priv->configs, folder_path, 
+                       config != NULL ? g_object_ref (config) : NULL);
+  
+  return config;
+}
+
+static CtagsConfig*
+load_config (CodeSlayerProject *project,
+             const gchar       *folder_path)
+{
+  CtagsConfig *config;
+  GKeyFile *key_file;
+  gchar *source_folder;
+  gchar *file_path;
+  
   file_path = g_build_filename (folder_path, CTAGS_CONF, NULL);
   
   if (!codeslayer_utils_file_exists (file_path))
     {
-      g_free (folder_path);
       g_free (file_path);
       return NULL;
     }
@@ -197,7 +448,6 @@ get_config_by_project (CtagsEngine       *engine,
   ctags_config_set_project (config, project);
   ctags_config_set_source_folder (config, source_folder);
   
-  g_free (folder_path);
   g_free (file_path);
   g_free (source_folder);
   g_key_file_free (key_file);
@@ -205,6 +455,73 @@ get_config_by_project (CtagsEngine       *engine,
   return config;
 }
 
+static void
+watch_config (CtagsEngine *engine,
+              const gchar *folder_path)
+{
+  CtagsEnginePrivate *priv;
+  GFileMonitor *monitor;
+  GFile *file;
+  gchar *file_path;
+  
+  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
+  
+  if (g_hash_table_lookup (priv->config_monitors, folder_path) != NULL)
+    return;
+  
+  file_path = g_build_filename (folder_path, CTAGS_CONF, NULL);
+  file = g_file_new_for_path (file_path);
+  monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
+  
+  if (monitor != NULL)
+    {
+      g_signal_connect (G_OBJECT (monitor), "changed",
+                        G_CALLBACK (config_changed_action), engine);
+      g_hash_table_insert (priv->config_monitors, g_strdup (folder_path), monitor);
+    }
+  
+  g_object_unref (file);
+  g_free (file_path);
+}
+
+/*
+ * Drops the cached config so that it is read again when next needed.
+ */
+static void
+config_changed_action (GFileMonitor      *monitor,
+                       GFile             *file,
+                       GFile             *other_file,
+                       GFileMonitorEvent  event_type,
+                       CtagsEngine       *engine)
+{
+  CtagsEnginePrivate *priv;
+  GFile *folder;
+  gchar *folder_path;
+  
+  if (event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+    return;
+  
+  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
+  
+  folder = g_file_get_parent (file);
+  folder_path = g_file_get_path (folder);
+  
+  if (folder_path != NULL)
+    g_hash_table_remove (priv->configs, folder_path);
+  
+  g_free (folder_path);
+  g_object_unref (folder);
+  
+  sync_project_tags (engine);
+}
+
+static void
+free_config (CtagsConfig *config)
+{
+  if (config != NULL)
+    g_object_unref (config);
+}
+
 static void
 project_properties_opened_action (CtagsEngine       *engine,
                                   CodeSlayerProject *project)
@@ -239,6 +556,8 @@ save_config_action (CtagsEngine *engine,
 {
   CtagsEnginePrivate *priv;
   CodeSlayerProject *project;
+  ProjectTags *project_tags;
+  CtagsConfig *cached_config;
   gchar *folder_path;
   gchar *file_path;
   const gchar *source_folder;
@@ -256,273 +575,1315 @@ save_config_action (CtagsEngine *engine,
 
   codeslayer_utils_save_key_file (key_file, file_path);  
   g_key_file_free (key_file);
-  g_free (folder_path);
+  
+  cached_config = ctags_config_new ();
+  ctags_config_set_project (cached_config, project);
+  ctags_config_set_source_folder (cached_config, source_folder);
+  watch_config (engine, folder_path);
+  g_hash_table_replace (priv->configs, folder_path, cached_config);
+  
   g_free (file_path);
   
-  execute_create_tags (engine);
-}
-
-static void 
-document_saved_action (CtagsEngine        *engine, 
-                       CodeSlayerDocument *document) 
-{
-  execute_create_tags (engine);
+  project_tags = get_project_tags (engine, project);
+  if (project_tags != NULL)
+    {
+      project_tags->rebuild = TRUE;
+      restart_create_tags (project_tags);
+    }
 }
 
 /*
- * wait a second before we regenerate the tag file in case 
- * we are saving multiple documents at once.
+ * Returns the tags of the project, or NULL if it is not configured for tagging.
  */
-static void
-execute_create_tags (CtagsEngine *engine) 
+static ProjectTags*
+get_project_tags (CtagsEngine       *engine,
+                  CodeSlayerProject *project)
 {
   CtagsEnginePrivate *priv;
+  ProjectTags *project_tags;
+  CtagsConfig *config;
+  const gchar *source_folder = NULL;
+  gchar *folder_path;
+  gchar *tag_file_path;
+  
   priv = CTAGS_ENGINE_GET_PRIVATE (engine);
-
-  if (priv->event_source_id == 0)
+  
+  folder_path = codeslayer_get_project_config_folder_path (priv->codeslayer, project);
+  project_tags = g_hash_table_lookup (priv->project_tags, folder_path);
+  
+  config = get_config_by_project (engine, project);
+  if (config != NULL)
+    source_folder = ctags_config_get_source_folder (config);
+  
+  if (config == NULL || source_folder == NULL || *source_folder == '\0')
     {
-      priv->event_source_id = g_timeout_add_seconds_full (G_PRIORITY_DEFAULT, 2,
-                                                          (GSourceFunc ) start_create_tags,
-                                                          engine,
-                                                          (GDestroyNotify) finish_create_tags);
+      if (project_tags != NULL)
+        remove_project_tags (project_tags);
+      if (config != NULL)
+        g_object_unref (config);
+      g_free (folder_path);
+      return NULL;
+    }
+  
+  if (project_tags == NULL)
+    {
+      project_tags = g_slice_new0 (ProjectTags);
+      project_tags->engine = engine;
+      project_tags->folder_path = folder_path;
+      project_tags->file_flags = g_array_new (FALSE, TRUE, sizeof (guint8));
+      project_tags->saved_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      project_tags->state = SCHEDULE_IDLE;
+      project_tags->update_time = 2 * G_USEC_PER_SEC;
+      
+      tag_file_path = g_build_filename (folder_path, TAGS, NULL);
+      project_tags->store = ctags_store_new (tag_file_path);
+      project_tags->generator = ctags_generator_new (tag_file_path);
+      g_free (tag_file_path);
+      
+      project_tags->finished_handler_id = g_signal_connect_swapped (G_OBJECT (project_tags->generator), "finished",
+                                                                    G_CALLBACK (create_tags_finished_action), project_tags);
+      
+      g_hash_table_insert (priv->project_tags, folder_path, project_tags);
+      
+      if (!codeslayer_utils_file_exists (ctags_store_get_file_path (project_tags->store)))
+        {
+          project_tags->rebuild = TRUE;
+          execute_create_tags (project_tags);
+        }
     }
+  else
+    {
+      g_free (folder_path);
+    }
+  
+  if (g_strcmp0 (project_tags->source_folder, source_folder) != 0)
+    {
+      g_free (project_tags->source_folder);
+      project_tags->source_folder = g_strdup (source_folder);
+      watch_source_folder (project_tags);
+    }
+  
+  g_object_unref (config);
+  
+  return project_tags;
 }
 
-static gboolean
-start_create_tags (CtagsEngine *engine)
+/*
+ * Returns the tags of every tagged project, those holding the file first.
+ */
+static GList*
+get_search_order (CtagsEngine *engine,
+                  const gchar *file_path)
 {
   CtagsEnginePrivate *priv;
-  FILE *file;
+  GList *search_order = NULL;
+  ProjectTags *first = NULL;
   GList *projects;
   GList *list;
-  GString *string;
-  gchar *command;
-  gchar *profile_folder_path;
 
   priv = CTAGS_ENGINE_GET_PRIVATE (engine);
   
-  profile_folder_path = codeslayer_get_profile_config_folder_path (priv->codeslayer);
-  
-  string = g_string_new ("cd ");
-  string = g_string_append (string, profile_folder_path);
-  string = g_string_append (string, ";ctags -R --fields=n");
-  
   projects = codeslayer_get_projects (priv->codeslayer);
   list = projects;
   while (list != NULL)
     {
-      CodeSlayerProject *project = list->data;
-      CtagsConfig *config = get_config_by_project (engine, project);
-      if (config != NULL)
+      ProjectTags *project_tags;
+      gchar *folder_path;
+      
+      folder_path = codeslayer_get_project_config_folder_path (priv->codeslayer, list->data);
+      project_tags = g_hash_table_lookup (priv->project_tags, folder_path);
+      g_free (folder_path);
+      
+      if (project_tags != NULL)
         {
-          const gchar *source_folder;
-          source_folder = ctags_config_get_source_folder (config);
-          string = g_string_append (string, " ");
-          string = g_string_append (string, source_folder);
-          g_object_unref (config);
+          if (first == NULL && file_path != NULL && 
+              is_in_folder (file_path, project_tags->source_folder))
+            first = project_tags;
+          else
+            search_order = g_list_prepend (search_order, project_tags);
         }
       list = g_list_next (list);
     }
   g_list_free (projects);
-
-  command = g_string_free (string, FALSE);
-  file = popen (command, "r");
   
-  if (file != NULL)
-    pclose (file);
+  search_order = g_list_reverse (search_order);
+  if (first != NULL)
+    search_order = g_list_prepend (search_order, first);
   
-  g_free (command);
-  g_free (profile_folder_path);
-  
-  return FALSE;  
+  return search_order;
 }
 
+/*
+ * Matches the tags to the open projects and their configs.
+ */
 static void
-finish_create_tags (CtagsEngine *engine)
+sync_project_tags (CtagsEngine *engine)
 {
   CtagsEnginePrivate *priv;
+  GHashTable *folder_paths;
+  GHashTableIter iter;
+  ProjectTags *project_tags;
+  GList *removed = NULL;
+  GList *projects;
+  GList *list;
+  
   priv = CTAGS_ENGINE_GET_PRIVATE (engine);
-  priv->event_source_id = 0;
-}
-
-static GList*
-find_tags (CodeSlayer        *codeslayer, 
-           const char *const  name, 
-           const int          options)
-{
-  GList *results = NULL; 
-
-	tagFileInfo info;
-	tagFile *tag_file;
-	tagEntry entry;
-	gchar *profile_folder_path;
-	gchar *tag_file_path;
-	
-  profile_folder_path = codeslayer_get_profile_config_folder_path (codeslayer);
-  tag_file_path = g_build_filename (profile_folder_path, "tags", NULL);
-	tag_file = tagsOpen (tag_file_path, &info);
-
-	if (tag_file == NULL)
-  	{
-  	  g_warning ("Could not open the tags file");
-		  return NULL;
-	  }
-	
-  if (tagsFind (tag_file, &entry, name, options) == TagSuccess)
-    {
-      do
-	      {
-	        Tag *tag;
-	        tag = g_malloc (sizeof (Tag));
-	        tag->file_path = g_strdup (entry.file);
-	        tag->line_number = entry.address.lineNumber;
-          results = g_list_prepend (results, tag);
-			  } while (tagsFindNext (tag_file, &entry) == TagSuccess);
-			  results = g_list_reverse (results);
+  
+  folder_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  projects = codeslayer_get_projects (priv->codeslayer);
+  for (list = projects; list != NULL; list = g_list_next (list))
+    {
+      get_project_tags (engine, list->data);
+      g_hash_table_add (folder_paths, 
+                        codeslayer_get_project_config_folder_path (priv->codeslayer, list->data));
     }
-    
-  tagsClose (tag_file);
+  g_list_free (projects);
   
-  g_free (profile_folder_path);
-  g_free (tag_file_path);
+  g_hash_table_iter_init (&iter, priv->project_tags);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &project_tags))
+    if (!g_hash_table_contains (folder_paths, project_tags->folder_path))
+      removed = g_list_prepend (removed, project_tags);
   
-  return results;
+  g_list_foreach (removed, (GFunc) remove_project_tags, NULL);
+  g_list_free (removed);
+  g_hash_table_destroy (folder_paths);
 }
 
-static void 
-find_tag_action (CtagsEngine *engine)
+/*
+ * Takes the project off the warm-up queue before dropping its tags.
+ */
+static void
+remove_project_tags (ProjectTags *project_tags)
 {
   CtagsEnginePrivate *priv;
-  CodeSlayerDocument *document;
-  GtkSourceView *source_view;
-  GtkTextBuffer *buffer;
-  GList *tags;
-  GList *tmp;
-
-  GtkTextMark *insert_mark;
-  GtkTextMark *selection_mark;
-  gchar *text;
-
-  GtkTextIter start, end;
-
-  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
-
-  document = codeslayer_get_active_document (priv->codeslayer);
-  
-  if (document == NULL)
-    return;
-  
-  source_view = codeslayer_document_get_source_view (document);
-  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (source_view));
-
-  insert_mark = gtk_text_buffer_get_insert (buffer);    
-  selection_mark = gtk_text_buffer_get_selection_bound (buffer);
-
-  gtk_text_buffer_get_iter_at_mark (buffer, &start, insert_mark);
-  gtk_text_buffer_get_iter_at_mark (buffer, &end, selection_mark);
-
-  text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
-  
-  if (text != NULL)
-    g_strstrip (text);
+  WarmUpStep last;
   
-  tags = find_tags (priv->codeslayer, text, 0);
-  tmp = tags;
+  priv = CTAGS_ENGINE_GET_PRIVATE (project_tags->engine);
   
-  if (tmp != NULL)
+  if (project_tags->warm_up_queued)
     {
-      gboolean found;
-      found = search_active_document (engine, document, tmp);
-      if (!found)
-        found = search_projects (engine, tmp, FALSE);
-      if (!found)
-        search_projects (engine, tmp, TRUE);
-  
-      while (tmp != NULL)
+      last = project_tags->warm_up_indexes ? WARM_UP_SYMBOLS : WARM_UP_OPEN;
+      if (g_queue_peek_head (priv->warm_up_queue) == project_tags)
+        {
+          priv->warm_up_done += last - priv->warm_up_step + 1;
+          priv->warm_up_step = WARM_UP_OPEN;
+        }
+      else
+        {
+          priv->warm_up_done += last + 1;
+        }
+      g_queue_remove (priv->warm_up_queue, project_tags);
+      
+      if (g_queue_is_empty (priv->warm_up_queue))
         {
-          Tag *tag = tmp->data;
-          g_free (tag->file_path);
-          tmp = g_list_next (tmp);
+          g_source_remove (priv->warm_up_source_id);
+          priv->warm_up_done = 0;
+          priv->warm_up_total = 0;
+          priv->warm_up_source_id = 0;
         }
-      g_list_foreach (tags, (GFunc) g_free, NULL);
-      g_list_free (tags);
     }
-    
-  if (text != NULL)
-    g_free (text);
+  
+  g_hash_table_remove (priv->project_tags, project_tags->folder_path);
 }
 
-static gboolean
-search_active_document (CtagsEngine        *engine, 
-                        CodeSlayerDocument *document, 
-                        GList              *tags)
+static void
+free_project_tags (ProjectTags *project_tags)
 {
-	const gchar *document_file_path;
-	
-	document_file_path = codeslayer_document_get_file_path (document);
-
-  while (tags != NULL)
+  if (project_tags->event_source_id != 0)
+    g_source_remove (project_tags->event_source_id);
+  
+  if (project_tags->watcher != NULL)
     {
-      Tag *tag = tags->data;
-      if (g_strcmp0 (document_file_path, tag->file_path) == 0)
-        {
-          select_document (engine, tag);
-          return TRUE;
-        }
-      tags = g_list_next (tags);
+      g_signal_handler_disconnect (project_tags->watcher, project_tags->changed_handler_id);
+      g_object_unref (project_tags->watcher);
     }
     
-  return FALSE;    
+  g_signal_handler_disconnect (project_tags->generator, project_tags->finished_handler_id);
+  ctags_generator_cancel (project_tags->generator);
+  g_object_unref (project_tags->generator);
+  g_object_unref (project_tags->store);
+  
+  if (project_tags->running_paths != NULL)
+    g_hash_table_destroy (project_tags->running_paths);
+  
+  tagsFreeMatchSet (&project_tags->matches);
+  g_array_free (project_tags->file_flags, TRUE);
+  g_hash_table_destroy (project_tags->saved_paths);
+  g_free (project_tags->folder_path);
+  g_free (project_tags->source_folder);
+  g_slice_free (ProjectTags, project_tags);
 }
 
-static gboolean
-search_projects (CtagsEngine *engine, 
-                 GList       *tags, 
-                 gboolean     search_headers)
+/*
+ * The first walk reports the files modified since the tags file was written.
+ */
+static void
+watch_source_folder (ProjectTags *project_tags)
 {
-  while (tags != NULL)
+  GStatBuf stat_buf;
+  gint64 since = -1;
+  
+  if (project_tags->watcher != NULL)
     {
-      Tag *tag = tags->data;
-      if (search_headers || !g_str_has_suffix (tag->file_path, ".h"))
-        {
-          select_document (engine, tag);
-          return TRUE;
-        }
-      tags = g_list_next (tags);
+      g_signal_handler_disconnect (project_tags->watcher, project_tags->changed_handler_id);
+      g_object_unref (project_tags->watcher);
     }
   
-  return FALSE;    
+  if (g_stat (ctags_store_get_file_path (project_tags->store), &stat_buf) == 0)
+    since = stat_buf.st_mtime;
+  
+  project_tags->watcher = ctags_watcher_new (project_tags->source_folder, since);
+  project_tags->changed_handler_id = g_signal_connect_swapped (G_OBJECT (project_tags->watcher), "changed",
+                                                               G_CALLBACK (source_changed_action), project_tags);
 }
 
 static void
-select_document (CtagsEngine *engine, 
-                 Tag         *tag)
+source_changed_action (ProjectTags *project_tags)
 {
-  CtagsEnginePrivate *priv;
-  CodeSlayerDocument *from;
-  const gchar* from_file_path;
-  gint from_line_number;
+  GList *changes;
+  GList *list;
+  gboolean rebuild;
   
-  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
+  changes = ctags_watcher_take_changes (project_tags->watcher, &rebuild);
   
-  from = codeslayer_get_active_document (priv->codeslayer);
-  from_file_path = codeslayer_document_get_file_path (from);
-  from_line_number = codeslayer_document_get_line_number (from);
-
-  if (codeslayer_select_document_by_file_path (priv->codeslayer, tag->file_path, tag->line_number))
+  list = changes;
+  while (list != NULL)
     {
-      CodeSlayerDocument *to;
-      const gchar* to_file_path;
-      gint to_line_number;
-      
-      to = codeslayer_get_active_document (priv->codeslayer);
-      to_file_path = codeslayer_document_get_file_path (to);
-      to_line_number = codeslayer_document_get_line_number (to);
+      g_hash_table_add (project_tags->saved_paths, list->data);
+      list = g_list_next (list);
+    }
+  g_list_free (changes);
+  
+  if (rebuild)
+    project_tags->rebuild = TRUE;
+  
+  execute_create_tags (project_tags);
+}
+
+static void 
+document_saved_action (CtagsEngine        *engine, 
+                       CodeSlayerDocument *document) 
+{
+  const gchar *file_path;
+  GList *search_order;
+  
+  file_path = codeslayer_document_get_file_path (document);
+  if (file_path == NULL)
+    return;
+  
+  search_order = get_search_order (engine, file_path);
+  
+  if (search_order != NULL)
+    {
+      ProjectTags *project_tags = search_order->data;
+      if (is_in_folder (file_path, project_tags->source_folder))
+        {
+          g_hash_table_add (project_tags->saved_paths, g_strdup (file_path));
+          execute_create_tags (project_tags);
+        }
+    }
+  
+  g_list_free (search_order);
+}
+
+static void 
+rebuild_tags_action (CtagsEngine *engine) 
+{
+  GList *search_order;
+  GList *list;
+  
+  search_order = get_search_order (engine, NULL);
+  
+  list = search_order;
+  while (list != NULL)
+    {
+      ProjectTags *project_tags = list->data;
+      project_tags->rebuild = TRUE;
+      restart_create_tags (project_tags);
+      list = g_list_next (list);
+    }
+  
+  g_list_free (search_order);
+}
+
+/*
+ * A rebuild cancels the run in progress rather than waiting for it.
+ */
+static void
+restart_create_tags (ProjectTags *project_tags)
+{
+  if (project_tags->state == SCHEDULE_RUNNING || 
+      project_tags->state == SCHEDULE_RUNNING_DIRTY)
+    {
+      project_tags->cancelled = TRUE;
+      ctags_generator_cancel (project_tags->generator);
+    }
+  
+  execute_create_tags (project_tags);
+}
+
+/*
+ * Changes are tagged after a delay, so that a burst of them makes a single run.
+ */
+static void
+execute_create_tags (ProjectTags *project_tags) 
+{
+  switch (project_tags->state)
+    {
+    case SCHEDULE_IDLE:
+      project_tags->state = SCHEDULE_PENDING;
+      ctags_trace_async_begin ("tags", "pending", project_tags);
+      project_tags->event_source_id = g_timeout_add_full (G_PRIORITY_DEFAULT, 
+                                                          get_delay (project_tags),
+                                                          (GSourceFunc ) start_create_tags,
+                                                          project_tags,
+                                                          (GDestroyNotify) finish_create_tags);
+      break;
+    case SCHEDULE_RUNNING:
+      project_tags->state = SCHEDULE_RUNNING_DIRTY;
+      break;
+    case SCHEDULE_PENDING:
+    case SCHEDULE_RUNNING_DIRTY:
+      break;
+    }
+}
+
+/*
+ * Waits about as long as an update took recently.
+ */
+static guint
+get_delay (ProjectTags *project_tags)
+{
+  return CLAMP (project_tags->update_time / 1000, MIN_DELAY, MAX_DELAY);
+}
+
+/*
+ * Rebuilds if asked to or if there is no tags file yet, else updates.
+ */
+static gboolean
+start_create_tags (ProjectTags *project_tags)
+{
+  GHashTable *saved_paths;
+  const gchar *tag_file_path;
+  gboolean started;
+
+  ctags_trace_async_end ("tags", "pending", project_tags);
+
+  saved_paths = project_tags->saved_paths;
+  project_tags->saved_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  
+  tag_file_path = ctags_store_get_file_path (project_tags->store);
+  
+  project_tags->running_rebuild = project_tags->rebuild || 
+                                  g_hash_table_size (saved_paths) == 0 ||
+                                  !codeslayer_utils_file_exists (tag_file_path);
+  
+  if (project_tags->running_rebuild)
+    started = create_tags (project_tags);
+  else
+    started = update_tags (project_tags, saved_paths);
+  
+  project_tags->rebuild = FALSE;
+  project_tags->cancelled = FALSE;
+  
+  if (started)
+    {
+      project_tags->state = SCHEDULE_RUNNING;
+      project_tags->started_time = g_get_monotonic_time ();
+      project_tags->running_paths = saved_paths;
+      ctags_trace_async_begin ("tags", get_run_name (project_tags), project_tags);
+    }
+  else
+    {
+      project_tags->state = SCHEDULE_IDLE;
+      g_hash_table_destroy (saved_paths);
+    }
+  
+  return FALSE;  
+}
+
+static gboolean
+create_tags (ProjectTags *project_tags)
+{
+  GList *source_folders;
+  gboolean started;
+  
+  source_folders = g_list_append (NULL, project_tags->source_folder);
+  started = ctags_generator_rebuild (project_tags->generator, source_folders);
+  g_list_free (source_folders);
+  
+  return started;
+}
+
+static gboolean
+update_tags (ProjectTags *project_tags, 
+             GHashTable  *saved_paths)
+{
+  GList *file_paths;
+  gboolean started;
+
+  file_paths = g_hash_table_get_keys (saved_paths);
+  started = ctags_generator_update (project_tags->generator, file_paths);
+  g_list_free (file_paths);
+  
+  return started;
+}
+
+/*
+ * Failed runs queue their files again; a failed update forces a rebuild.
+ */
+static void
+create_tags_finished_action (ProjectTags *project_tags,
+                             gboolean     success)
+{
+  gboolean dirty;
+  gboolean retry;
+  
+  dirty = project_tags->state == SCHEDULE_RUNNING_DIRTY;
+  project_tags->state = SCHEDULE_IDLE;
+  
+  ctags_trace_async_end ("tags", get_run_name (project_tags), project_tags);
+  record_run (project_tags, success);
+  
+  if (success)
+    {
+      CTAGS_ENGINE_GET_PRIVATE (project_tags->engine)->generation++;
+      warm_up_project (project_tags, FALSE);
+    }
+  
+  if (success && !project_tags->running_rebuild)
+    {
+      gint64 time = g_get_monotonic_time () - project_tags->started_time;
+      project_tags->update_time = (3 * project_tags->update_time + time) / 4;
+    }
+  
+  retry = success || dirty || !project_tags->running_rebuild;
+  
+  if (!success)
+    {
+      GHashTableIter iter;
+      gpointer key;
+      
+      g_hash_table_iter_init (&iter, project_tags->running_paths);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        g_hash_table_add (project_tags->saved_paths, g_strdup (key));
+      
+      if (project_tags->running_rebuild || !project_tags->cancelled)
+        project_tags->rebuild = TRUE;
+    }
+  
+  g_hash_table_destroy (project_tags->running_paths);
+  project_tags->running_paths = NULL;
+  project_tags->cancelled = FALSE;
+  
+  if (retry && (project_tags->rebuild || g_hash_table_size (project_tags->saved_paths) > 0))
+    execute_create_tags (project_tags);
+}
+
+static const gchar*
+get_run_name (ProjectTags *project_tags)
+{
+  return project_tags->running_rebuild ? "rebuild" : "update";
+}
+
+/*
+ * Cancelled runs count as failed ones.
+ */
+static void
+record_run (ProjectTags *project_tags,
+            gboolean     success)
+{
+  CtagsStats *stats;
+  GStatBuf stat_buf;
+  
+  stats = CTAGS_ENGINE_GET_PRIVATE (project_tags->engine)->stats;
+  
+  ctags_stats_increment (stats, project_tags->running_rebuild ? 
+                                CTAGS_STATS_REBUILDS : CTAGS_STATS_UPDATES);
+  
+  if (!success)
+    {
+      ctags_stats_increment (stats, CTAGS_STATS_FAILED_RUNS);
+      return;
+    }
+  
+  ctags_stats_record (stats, CTAGS_STATS_GENERATION_TIME, 
+                      g_get_monotonic_time () - project_tags->started_time);
+  ctags_stats_record (stats, CTAGS_STATS_FILES_TAGGED, 
+                      ctags_generator_get_files_tagged (project_tags->generator));
+  
+  if (g_stat (ctags_store_get_file_path (project_tags->store), &stat_buf) == 0)
+    ctags_stats_record (stats, CTAGS_STATS_TAGS_FILE_SIZE, stat_buf.st_size);
+}
+
+static void
+projects_changed_action (CtagsEngine *engine)
+{
+  sync_project_tags (engine);
+  ctags_engine_warm_up (engine);
+}
+
+/*
+ * Warms up the tags of every project, in the background. Projects opened 
+ * later are warmed up as they come.
+ */
+void
+ctags_engine_warm_up (CtagsEngine *engine)
+{
+  GList *search_order;
+  GList *list;
+  
+  search_order = get_search_order (engine, NULL);
+  list = search_order;
+  while (list != NULL)
+    {
+      warm_up_project (list->data, TRUE);
+      list = g_list_next (list);
+    }
+  g_list_free (search_order);
+}
+
+/*
+ * Returns how much of the warm-up queued so far is done, from 0 to 1, 
+ * which is 1 when there is nothing left to do.
+ */
+gdouble
+ctags_engine_get_warm_up_progress (CtagsEngine *engine)
+{
+  CtagsEnginePrivate *priv;
+  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
+  
+  if (priv->warm_up_total == 0)
+    return 1.0;
+  
+  return (gdouble) priv->warm_up_done / priv->warm_up_total;
+}
+
+/*
+ * Queues the project for warming up, with its indexes if asked for.
+ */
+static void
+warm_up_project (ProjectTags *project_tags,
+                 gboolean     indexes)
+{
+  CtagsEnginePrivate *priv;
+  priv = CTAGS_ENGINE_GET_PRIVATE (project_tags->engine);
+  
+  if (project_tags->warm_up_queued)
+    {
+      /* a project queued without its indexes has not gone past opening */
+      if (indexes && !project_tags->warm_up_indexes)
+        {
+          project_tags->warm_up_indexes = TRUE;
+          priv->warm_up_total += WARM_UP_STEPS - 1;
+        }
+      return;
+    }
+  
+  project_tags->warm_up_queued = TRUE;
+  project_tags->warm_up_indexes = indexes;
+  g_queue_push_tail (priv->warm_up_queue, project_tags);
+  priv->warm_up_total += indexes ? WARM_UP_STEPS : 1;
+  
+  if (priv->warm_up_source_id == 0)
+    priv->warm_up_source_id = g_idle_add_full (G_PRIORITY_LOW, (GSourceFunc) warm_up, 
+                                               project_tags->engine, NULL);
+}
+
+/*
+ * Takes one step of warming up the project at the head of the queue.
+ */
+static gboolean
+warm_up (CtagsEngine *engine)
+{
+  CtagsEnginePrivate *priv;
+  ProjectTags *project_tags;
+  WarmUpStep last;
+  tagFile *tag_file;
+  
+  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
+  
+  project_tags = g_queue_peek_head (priv->warm_up_queue);
+  last = project_tags->warm_up_indexes ? WARM_UP_SYMBOLS : WARM_UP_OPEN;
+  
+  switch (priv->warm_up_step)
+    {
+    case WARM_UP_OPEN:
+      tag_file = ctags_store_get_tag_file (project_tags->store);
+      if (tag_file != NULL)
+        tagsPrefetch (tag_file);
+      else
+        last = WARM_UP_OPEN;
+      break;
+    case WARM_UP_NAMES:
+      ctags_store_get_name_index (project_tags->store);
+      break;
+    case WARM_UP_SYMBOLS:
+      ctags_store_get_symbol_index (project_tags->store);
+      break;
+    default:
+      break;
+    }
+  
+  if (priv->warm_up_step < last)
+    {
+      priv->warm_up_step++;
+      priv->warm_up_done++;
+    }
+  else
+    {
+      priv->warm_up_done += (project_tags->warm_up_indexes ? WARM_UP_SYMBOLS : WARM_UP_OPEN) 
+                            - priv->warm_up_step + 1;
+      priv->warm_up_step = WARM_UP_OPEN;
+      project_tags->warm_up_queued = FALSE;
+      g_queue_pop_head (priv->warm_up_queue);
+    }
+  
+  g_signal_emit_by_name ((gpointer) engine, "warm-up-progress", 
+                         ctags_engine_get_warm_up_progress (engine));
+  
+  if (!g_queue_is_empty (priv->warm_up_queue))
+    return TRUE;
+  
+  priv->warm_up_done = 0;
+  priv->warm_up_total = 0;
+  priv->warm_up_source_id = 0;
+  
+  return FALSE;
+}
+
+static gboolean
+is_in_folder (const gchar *file_path,
+              const gchar *folder_path)
+{
+  gsize length = strlen (folder_path);
+  
+  if (length == 0 || strncmp (file_path, folder_path, length) != 0)
+    return FALSE;
+  
+  return folder_path[length - 1] == G_DIR_SEPARATOR || 
+         file_path[length] == G_DIR_SEPARATOR;
+}
+
+static void
+finish_create_tags (ProjectTags *project_tags)
+{
+  if (project_tags->state == SCHEDULE_PENDING)
+    ctags_trace_async_end ("tags", "pending", project_tags);
+  project_tags->event_source_id = 0;
+}
+
+/*
+ * The matches stay valid until the next lookup.
+ */
+static tagMatchSet*
+find_tags (ProjectTags       *project_tags, 
+           tagFile           *tag_file,
+           const char *const  name, 
+           const int          options)
+{
+  project_tags->matches.count = 0;
+
+  if (tag_file == NULL)
+    return NULL;
+
+  if (tagsFindAll (tag_file, &project_tags->matches, name, options) != TagSuccess)
+    return NULL;
+    
+  return &project_tags->matches;
+}
+
+/*
+ * Returns up to max names starting with prefix, to be freed with g_strfreev().
+ */
+gchar**
+ctags_engine_complete_tag (CtagsEngine *engine,
+                           const gchar *prefix,
+                           guint        max,
+                           guint       *count)
+{
+  GList *search_order;
+  GList *list;
+  GPtrArray *names;
+  gchar **results;
+  guint total = 0;
+  guint length = 0;
+  guint i;
+
+  names = g_ptr_array_new ();
+  
+  search_order = get_search_order (engine, NULL);
+  list = search_order;
+  while (list != NULL)
+    {
+      ProjectTags *project_tags = list->data;
+      CtagsNameIndex *name_index;
+      name_index = ctags_store_get_name_index (project_tags->store);
+      if (name_index != NULL)
+        total += ctags_name_index_lookup (name_index, prefix, max, names);
+      list = g_list_next (list);
+    }
+  
+  /* the names of each project are in order, but not across projects */
+  if (search_order != NULL && search_order->next != NULL)
+    g_ptr_array_sort (names, (GCompareFunc) compare_names);
+  
+  results = g_new (gchar*, MIN (names->len, max) + 1);
+  for (i = 0; i < names->len && length < max; i++)
+    {
+      const gchar *name = g_ptr_array_index (names, i);
+      if (length == 0 || strcmp (results[length - 1], name) != 0)
+        results[length++] = g_strdup (name);
+    }
+  results[length] = NULL;
+  
+  g_ptr_array_free (names, TRUE);
+  g_list_free (search_order);
+  
+  if (count != NULL)
+    *count = total;
+  
+  return results;
+}
+
+/*
+ * Calls func with up to max names matching query, best match first.
+ */
+void
+ctags_engine_search_symbols (CtagsEngine     *engine,
+                             const gchar     *query,
+                             guint            max,
+                             CtagsSymbolFunc  func,
+                             gpointer         user_data)
+{
+  GList *search_order;
+  GList *list;
+  GArray *symbols;
+  GHashTable *seen;
+  guint length = 0;
+  guint i;
+
+  symbols = g_array_new (FALSE, FALSE, sizeof (Symbol));
+  
+  search_order = get_search_order (engine, NULL);
+  list = search_order;
+  while (list != NULL)
+    {
+      ProjectTags *project_tags = list->data;
+      CtagsSymbolIndex *symbol_index;
+      symbol_index = ctags_store_get_symbol_index (project_tags->store);
+      if (symbol_index != NULL)
+        ctags_symbol_index_search (symbol_index, query, max, 
+                                   (CtagsSymbolFunc) collect_symbol, symbols);
+      list = g_list_next (list);
+    }
+  g_list_free (search_order);
+  
+  g_array_sort (symbols, (GCompareFunc) compare_symbols);
+  
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+  for (i = 0; i < symbols->len && length < max; i++)
+    {
+      Symbol *symbol = &g_array_index (symbols, Symbol, i);
+      if (g_hash_table_lookup_extended (seen, symbol->name, NULL, NULL))
+        continue;
+      g_hash_table_add (seen, symbol->name);
+      length++;
+      if (!func (symbol->name, symbol->score, user_data))
+        break;
+    }
+  g_hash_table_destroy (seen);
+  
+  for (i = 0; i < symbols->len; i++)
+    g_free (g_array_index (symbols, Symbol, i).name);
+  g_array_free (symbols, TRUE);
+}
+
+/*
+ * Returns a number which changes whenever a new tags file is published.
+ */
+guint
+ctags_engine_get_generation (CtagsEngine *engine)
+{
+  return CTAGS_ENGINE_GET_PRIVATE (engine)->generation;
+}
+
+static gboolean
+collect_symbol (const gchar *name,
+                gint         score,
+                GArray      *symbols)
+{
+  Symbol symbol;
+  symbol.name = g_strdup (name);
+  symbol.score = score;
+  g_array_append_val (symbols, symbol);
+  return TRUE;
+}
+
+static gint
+compare_symbols (const Symbol *symbol1,
+                 const Symbol *symbol2)
+{
+  if (symbol1->score != symbol2->score)
+    return symbol1->score > symbol2->score ? -1 : 1;
+  return strcmp (symbol1->name, symbol2->name);
+}
+
+static gint
+compare_names (const gchar **name1,
+               const gchar **name2)
+{
+  return strcmp (*name1, *name2);
+}
+
+static void 
+find_tag_action (CtagsEngine *engine)
+{
+  find_tag (engine, TAG_OBSERVECASE);
+}
+
+static void 
+find_tag_ignore_case_action (CtagsEngine *engine)
+{
+  find_tag (engine, TAG_IGNORECASE);
+}
+
+static void 
+find_tag (CtagsEngine *engine,
+          const int    options)
+{
+  CtagsEnginePrivate *priv;
+  CodeSlayerDocument *document;
+  GtkSourceView *source_view;
+  gchar *text;
+
+  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
+
+  document = codeslayer_get_active_document (priv->codeslayer);
+  
+  if (document == NULL)
+    return;
+  
+  source_view = codeslayer_document_get_source_view (document);
+  text = get_selection (gtk_text_view_get_buffer (GTK_TEXT_VIEW (source_view)));
+  
+  goto_tag (engine, document, text, options);
+    
+  if (text != NULL)
+    g_free (text);
+}
+
+static gchar*
+get_selection (GtkTextBuffer *buffer)
+{
+  GtkTextMark *insert_mark;
+  GtkTextMark *selection_mark;
+  gchar *text;
+
+  GtkTextIter start, end;
+
+  insert_mark = gtk_text_buffer_get_insert (buffer);    
+  selection_mark = gtk_text_buffer_get_selection_bound (buffer);
+
+  gtk_text_buffer_get_iter_at_mark (buffer, &start, insert_mark);
+  gtk_text_buffer_get_iter_at_mark (buffer, &end, selection_mark);
+
+  text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+  
+  if (text != NULL)
+    g_strstrip (text);
+  
+  return text;
+}
+
+/*
+ * Each stage of a lookup is timed on its own.
+ */
+static void 
+goto_tag (CtagsEngine        *engine,
+          CodeSlayerDocument *document,
+          const gchar        *name,
+          const int           options)
+{
+  CtagsEnginePrivate *priv;
+  GList *search_order;
+  const tagMatch *match;
+  gint64 started_time;
+  gint64 lookup_trace_time;
+  gint64 trace_time;
+  gint64 time;
+  gint64 now;
+
+  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
+
+  search_order = get_search_order (engine, codeslayer_document_get_file_path (document));
+  if (search_order == NULL)
+    return;
+  
+  started_time = g_get_monotonic_time ();
+  lookup_trace_time = ctags_trace_now ();
+  
+  if (!open_tags (search_order))
+    g_warning ("Could not open the tags file");
+  
+  now = g_get_monotonic_time ();
+  ctags_stats_record (priv->stats, CTAGS_STATS_LOOKUP_OPEN, now - started_time);
+  
+  trace_time = ctags_trace_now ();
+  search_tags (search_order, name, options);
+  ctags_trace_span ("lookup", "search", trace_time, name);
+  
+  time = now;
+  now = g_get_monotonic_time ();
+  ctags_stats_record (priv->stats, CTAGS_STATS_LOOKUP_SEARCH, now - time);
+  ctags_stats_record (priv->stats, CTAGS_STATS_MATCHES, count_matches (search_order));
+  
+  trace_time = ctags_trace_now ();
+  match = rank_matches (search_order, document);
+  ctags_trace_span ("lookup", "rank", trace_time, NULL);
+  
+  time = now;
+  now = g_get_monotonic_time ();
+  ctags_stats_record (priv->stats, CTAGS_STATS_LOOKUP_RANK, now - time);
+  
+  if (match != NULL)
+    {
+      select_document (engine, match);
+      time = now;
+      now = g_get_monotonic_time ();
+      ctags_stats_record (priv->stats, CTAGS_STATS_LOOKUP_NAVIGATE, now - time);
+    }
+  else
+    {
+      ctags_stats_increment (priv->stats, CTAGS_STATS_MISSED_LOOKUPS);
+    }
+  
+  ctags_stats_increment (priv->stats, CTAGS_STATS_LOOKUPS);
+  ctags_stats_record (priv->stats, CTAGS_STATS_LOOKUP_TOTAL, now - started_time);
+  ctags_trace_span ("lookup", "goto_tag", lookup_trace_time, name);
+  
+  g_list_free (search_order);
+}
+
+/*
+ * The matches point into the handle, so it is fetched once per lookup.
+ */
+static gboolean
+open_tags (GList *search_order)
+{
+  gboolean opened = FALSE;
+  
+  for (; search_order != NULL; search_order = g_list_next (search_order))
+    {
+      ProjectTags *project_tags = search_order->data;
+      project_tags->tag_file = ctags_store_get_tag_file (project_tags->store);
+      if (project_tags->tag_file != NULL)
+        opened = TRUE;
+    }
+  
+  return opened;
+}
+
+static void
+search_tags (GList       *search_order,
+             const gchar *name,
+             const int    options)
+{
+  while (search_order != NULL)
+    {
+      ProjectTags *project_tags = search_order->data;
+      if (find_tags (project_tags, project_tags->tag_file, name, options) != NULL)
+        classify_files (project_tags);
+      search_order = g_list_next (search_order);
+    }
+}
+
+static gsize
+count_matches (GList *search_order)
+{
+  gsize count = 0;
+  
+  for (; search_order != NULL; search_order = g_list_next (search_order))
+    count += ((ProjectTags *) search_order->data)->matches.count;
+  
+  return count;
+}
+
+/*
+ * Prefers a match in the document, then one in a source file, then any other.
+ */
+static const tagMatch*
+rank_matches (GList              *search_order,
+              CodeSlayerDocument *document)
+{
+  const tagMatch *match;
+  
+  match = search_active_document (search_order->data, document);
+  if (match == NULL)
+    match = search_projects (search_order, FALSE);
+  if (match == NULL)
+    match = search_projects (search_order, TRUE);
+  
+  return match;
+}
+
+/*
+ * Lists the tag names matching the query as it is typed.
+ */
+static void 
+find_symbol_action (CtagsEngine *engine)
+{
+  CtagsEnginePrivate *priv;
+  CodeSlayerDocument *document;
+  SymbolDialog symbol_dialog;
+  GtkWidget *dialog;
+  GtkWidget *content_area;
+  GtkWidget *entry;
+  GtkWidget *scrolled_window;
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *renderer;
+  GtkTreeSelection *selection;
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+  gchar *name = NULL;
+  gint response;
+
+  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
+
+  document = codeslayer_get_active_document (priv->codeslayer);
+  
+  if (document == NULL)
+    return;
+  
+  dialog = gtk_dialog_new_with_buttons (_("Find Symbol"), 
+                                        NULL,
+                                        GTK_DIALOG_MODAL,
+                                        GTK_STOCK_CANCEL,
+                                        GTK_RESPONSE_CANCEL,
+                                        GTK_STOCK_OK,
+                                        GTK_RESPONSE_OK, 
+                                        NULL);
+  gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
+  content_area = gtk_dialog_get_content_area (GTK_DIALOG (dialog));
+  
+  entry = gtk_entry_new ();
+  gtk_entry_set_width_chars (GTK_ENTRY (entry), 50);
+  gtk_entry_set_activates_default (GTK_ENTRY (entry), TRUE);
+  gtk_box_pack_start (GTK_BOX (content_area), entry, FALSE, FALSE, 3);
+  
+  symbol_dialog.engine = engine;
+  symbol_dialog.store = gtk_list_store_new (1, G_TYPE_STRING);
+  symbol_dialog.tree = gtk_tree_view_new_with_model (GTK_TREE_MODEL (symbol_dialog.store));
+  gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (symbol_dialog.tree), FALSE);
+  
+  renderer = gtk_cell_renderer_text_new ();
+  column = gtk_tree_view_column_new_with_attributes (NULL, renderer, "text", 0, NULL);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (symbol_dialog.tree), column);
+  
+  scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled_window),
+                                  GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+  gtk_widget_set_size_request (scrolled_window, -1, 300);
+  gtk_container_add (GTK_CONTAINER (scrolled_window), symbol_dialog.tree);
+  gtk_box_pack_start (GTK_BOX (content_area), scrolled_window, TRUE, TRUE, 3);
+  
+  g_signal_connect (G_OBJECT (entry), "changed",
+                    G_CALLBACK (symbol_changed_action), &symbol_dialog);
+  
+  g_signal_connect_swapped (G_OBJECT (symbol_dialog.tree), "row-activated",
+                            G_CALLBACK (symbol_activated_action), dialog);
+  
+  gtk_widget_show_all (content_area);
+  
+  response = gtk_dialog_run (GTK_DIALOG (dialog));
+  if (response == GTK_RESPONSE_OK)
+    {
+      selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (symbol_dialog.tree));
+      if (gtk_tree_selection_get_selected (selection, &model, &iter))
+        gtk_tree_model_get (model, &iter, 0, &name, -1);
+    }
+
+  gtk_widget_destroy (dialog);
+  g_object_unref (symbol_dialog.store);
+  
+  if (name != NULL)
+    {
+      goto_tag (engine, document, name, TAG_OBSERVECASE);
+      g_free (name);
+    }
+}
+
+static void
+symbol_changed_action (GtkEntry     *entry,
+                       SymbolDialog *symbol_dialog)
+{
+  GtkTreeSelection *selection;
+  GtkTreeIter iter;
+
+  gtk_list_store_clear (symbol_dialog->store);
+  
+  ctags_engine_search_symbols (symbol_dialog->engine, gtk_entry_get_text (entry),
+                               SYMBOL_RESULTS, (CtagsSymbolFunc) add_symbol, 
+                               symbol_dialog->store);
+  
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (symbol_dialog->tree));
+  if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (symbol_dialog->store), &iter))
+    gtk_tree_selection_select_iter (selection, &iter);
+}
+
+static gboolean
+add_symbol (const gchar  *name,
+            gint          score,
+            GtkListStore *store)
+{
+  GtkTreeIter iter;
+  gtk_list_store_append (store, &iter);
+  gtk_list_store_set (store, &iter, 0, name, -1);
+  return TRUE;
+}
+
+static void
+symbol_activated_action (GtkDialog *dialog)
+{
+  gtk_dialog_response (dialog, GTK_RESPONSE_OK);
+}
+
+/*
+ * Works out once per generation of the tags file which files are headers.
+ */
+static void
+classify_files (ProjectTags *project_tags)
+{
+  tagMatchSet *matches = &project_tags->matches;
+  guint generation;
+  gsize i;
+
+  generation = ctags_store_get_generation (project_tags->store);
+  if (project_tags->file_flags_generation != generation)
+    {
+      g_array_set_size (project_tags->file_flags, 0);
+      project_tags->file_flags_generation = generation;
+    }
+
+  for (i = 0; i < matches->count; i++)
+    {
+      const tagMatch *match = &matches->list[i];
+      guint8 *flags;
+      
+      if (match->fileId >= project_tags->file_flags->len)
+        g_array_set_size (project_tags->file_flags, match->fileId + 1);
+      
+      flags = &g_array_index (project_tags->file_flags, guint8, match->fileId);
+      if (*flags & FILE_CLASSIFIED)
+        continue;
+      
+      *flags = FILE_CLASSIFIED;
+      if (g_str_has_suffix (match->file, ".h"))
+        *flags |= FILE_HEADER;
+    }
+}
+
+static const tagMatch*
+search_active_document (ProjectTags        *project_tags, 
+                        CodeSlayerDocument *document)
+{
+  tagMatchSet *matches = &project_tags->matches;
+	const gchar *document_file_path;
+  tagFile *tag_file;
+  gint file_id;
+  gsize i;
+  
+  if (matches->count == 0)
+    return NULL;
+  
+	document_file_path = codeslayer_document_get_file_path (document);
+  
+  tag_file = project_tags->tag_file;
+  file_id = tagsFileId (tag_file, document_file_path);
+  if (file_id < 0)
+    return NULL;
+
+  for (i = 0; i < matches->count; i++)
+    {
+      const tagMatch *match = &matches->list[i];
+      if (match->fileId == (guint) file_id)
+        return match;
+    }
+    
+  return NULL;    
+}
+
+static const tagMatch*
+search_projects (GList    *search_order, 
+                 gboolean  search_headers)
+{
+  while (search_order != NULL)
+    {
+      ProjectTags *project_tags = search_order->data;
+      tagMatchSet *matches = &project_tags->matches;
+      gsize i;
+
+      for (i = 0; i < matches->count; i++)
+        {
+          const tagMatch *match = &matches->list[i];
+          guint8 flags = g_array_index (project_tags->file_flags, guint8, match->fileId);
+          if (search_headers || !(flags & FILE_HEADER))
+            return match;
+        }
+      
+      search_order = g_list_next (search_order);
+    }
+  
+  return NULL;    
+}
+
+static void
+select_document (CtagsEngine    *engine, 
+                 const tagMatch *match)
+{
+  CtagsEnginePrivate *priv;
+  CodeSlayerDocument *from;
+  const gchar* from_file_path;
+  gint from_line_number;
+  
+  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
+  
+  from = codeslayer_get_active_document (priv->codeslayer);
+  from_file_path = codeslayer_document_get_file_path (from);
+  from_line_number = codeslayer_document_get_line_number (from);
+
+  if (select_file (engine, match->file, match->lineNumber))
+    {
+      CodeSlayerDocument *to;
+      const gchar* to_file_path;
+      gint to_line_number;
+      
+      to = codeslayer_get_active_document (priv->codeslayer);
+      to_file_path = codeslayer_document_get_file_path (to);
+      to_line_number = codeslayer_document_get_line_number (to);
       
       add_path (engine, from_file_path, from_line_number, to_file_path, to_line_number);
     }
 }
 
+static gboolean
+select_file (CtagsEngine *engine,
+             const gchar *file_path,
+             gint         line_number)
+{
+  CtagsEnginePrivate *priv;
+  gint64 trace_time;
+  gboolean result;
+  
+  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
+  
+  trace_time = ctags_trace_now ();
+  result = codeslayer_select_document_by_file_path (priv->codeslayer, file_path, line_number);
+  ctags_trace_span ("lookup", "codeslayer_select_document_by_file_path", trace_time, file_path);
+  
+  return result;
+}
+
 static CtagsPathNode*
 create_node (const gchar *file_path,
              gint         line_number)
@@ -620,7 +1981,7 @@ previous_action (CtagsEngine *engine)
   file_path = ctags_path_node_get_file_path (node);
   line_number = ctags_path_node_get_line_number (node);
   
-  codeslayer_select_document_by_file_path (priv->codeslayer, file_path, line_number);
+  select_file (engine, file_path, line_number);
 }
 
 static void
@@ -646,7 +2007,7 @@ next_action (CtagsEngine *engine)
   file_path = ctags_path_node_get_file_path (node);
   line_number = ctags_path_node_get_line_number (node);
   
-  if (!codeslayer_select_document_by_file_path (priv->codeslayer, file_path, line_number))
+  if (!select_file (engine, file_path, line_number))
     {
       clear_path (engine);    
     }
@@ -662,3 +2023,143 @@ clear_path (CtagsEngine *engine)
   priv->path = NULL;
   priv->position = 0;
 }
+
+static void
+show_statistics_action (CtagsEngine *engine)
+{
+  CtagsEnginePrivate *priv;
+  GtkWidget *dialog;
+  GtkWidget *content_area;
+  GtkWidget *scrolled_window;
+  GtkWidget *text_view;
+  GtkTextBuffer *buffer;
+  PangoFontDescription *font;
+  gint response;
+
+  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
+  
+  dialog = gtk_dialog_new_with_buttons (_("Ctags Statistics"), 
+                                        NULL,
+                                        GTK_DIALOG_MODAL,
+                                        GTK_STOCK_CLEAR,
+                                        GTK_RESPONSE_REJECT,
+                                        GTK_STOCK_SAVE_AS,
+                                        GTK_RESPONSE_APPLY,
+                                        GTK_STOCK_CLOSE,
+                                        GTK_RESPONSE_CLOSE, 
+                                        NULL);
+  gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_CLOSE);
+  content_area = gtk_dialog_get_content_area (GTK_DIALOG (dialog));
+  
+  text_view = gtk_text_view_new ();
+  gtk_text_view_set_editable (GTK_TEXT_VIEW (text_view), FALSE);
+  gtk_text_view_set_cursor_visible (GTK_TEXT_VIEW (text_view), FALSE);
+  font = pango_font_description_from_string ("monospace");
+  gtk_widget_override_font (text_view, font);
+  pango_font_description_free (font);
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (text_view));
+  
+  scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled_window),
+                                  GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+  gtk_widget_set_size_request (scrolled_window, 750, 350);
+  gtk_container_add (GTK_CONTAINER (scrolled_window), text_view);
+  gtk_box_pack_start (GTK_BOX (content_area), scrolled_window, TRUE, TRUE, 3);
+  
+  gtk_widget_show_all (content_area);
+  
+  do
+    {
+      gchar *text = ctags_stats_to_string (priv->stats);
+      gtk_text_buffer_set_text (buffer, text, -1);
+      g_free (text);
+      
+      response = gtk_dialog_run (GTK_DIALOG (dialog));
+      if (response == GTK_RESPONSE_APPLY)
+        save_statistics (engine, dialog);
+      else if (response == GTK_RESPONSE_REJECT)
+        ctags_stats_reset (priv->stats);
+    }
+  while (response == GTK_RESPONSE_APPLY || response == GTK_RESPONSE_REJECT);
+
+  gtk_widget_destroy (dialog);
+}
+
+static void
+save_statistics (CtagsEngine *engine,
+                 GtkWidget   *parent)
+{
+  CtagsEnginePrivate *priv;
+  GtkWidget *dialog;
+  
+  priv = CTAGS_ENGINE_GET_PRIVATE (engine);
+  
+  dialog = gtk_file_chooser_dialog_new (_("Save Ctags Statistics"), 
+                                        GTK_WINDOW (parent),
+                                        GTK_FILE_CHOOSER_ACTION_SAVE,
+                                        GTK_STOCK_CANCEL,
+                                        GTK_RESPONSE_CANCEL,
+                                        GTK_STOCK_SAVE,
+                                        GTK_RESPONSE_ACCEPT, 
+                                        NULL);
+  gtk_file_chooser_set_do_overwrite_confirmation (GTK_FILE_CHOOSER (dialog), TRUE);
+  gtk_file_chooser_set_current_name (GTK_FILE_CHOOSER (dialog), "ctags-statistics.txt");
+  
+  if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT)
+    {
+      GError *error = NULL;
+      gchar *file_path;
+      
+      file_path = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (dialog));
+      if (!ctags_stats_save (priv->stats, file_path, &error))
+        {
+          g_warning ("Could not save the statistics: %s", error->message);
+          g_error_free (error);
+        }
+      g_free (file_path);
+    }
+  
+  gtk_widget_destroy (dialog);
+}
+
+/*
+ * A trace started from the menu goes into the temporary folder.
+ */
+static void
+trace_action (CtagsEngine *engine,
+              gboolean     active)
+{
+  GtkWidget *dialog;
+  
+  if (active)
+    {
+      GError *error = NULL;
+      gchar *file_name;
+      gchar *file_path;
+      
+      file_name = g_strdup_printf ("ctags-trace-%d-%" G_GINT64_FORMAT ".json", 
+                                   (gint) getpid (), g_get_real_time () / G_USEC_PER_SEC);
+      file_path = g_build_filename (g_get_tmp_dir (), file_name, NULL);
+      
+      if (!ctags_trace_start (file_path, &error))
+        {
+          g_warning ("Could not start tracing: %s", error->message);
+          g_error_free (error);
+        }
+      
+      g_free (file_path);
+      g_free (file_name);
+      return;
+    }
+  
+  if (!ctags_trace_is_running ())
+    return;
+  
+  ctags_trace_stop ();
+  
+  dialog = gtk_message_dialog_new (NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_INFO, 
+                                   GTK_BUTTONS_CLOSE, _("The trace was written to %s"), 
+                                   ctags_trace_get_file_path ());
+  gtk_dialog_run (GTK_DIALOG (dialog));
+  gtk_widget_destroy (dialog);
+}
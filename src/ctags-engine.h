@@ -21,6 +21,7 @@
 
 #include <gtk/gtk.h>
 #include <codeslayer/codeslayer.h>
+#include "ctags-symbol-index.h"
 
 G_BEGIN_DECLS
 
@@ -41,6 +42,9 @@ struct _CtagsEngine
 struct _CtagsEngineClass
 {
   GObjectClass parent_class;
+  
+  void (*warm_up_progress) (CtagsEngine *engine,
+                            gdouble      fraction);
 };
 
 GType ctags_engine_get_type (void) G_GNUC_CONST;
@@ -49,6 +53,22 @@ CtagsEngine*  ctags_engine_new                  (CodeSlayer *codeslayer,
                                                  GtkWidget  *menu,
                                                  GtkWidget  *project_properties);
 
+gchar**       ctags_engine_complete_tag         (CtagsEngine *engine,
+                                                 const gchar *prefix,
+                                                 guint        max,
+                                                 guint       *count);
+
+void          ctags_engine_search_symbols       (CtagsEngine     *engine,
+                                                 const gchar     *query,
+                                                 guint            max,
+                                                 CtagsSymbolFunc  func,
+                                                 gpointer         user_data);
+
+guint         ctags_engine_get_generation       (CtagsEngine *engine);
+
+void          ctags_engine_warm_up              (CtagsEngine *engine);
+gdouble       ctags_engine_get_warm_up_progress (CtagsEngine *engine);
+
 G_END_DECLS
 
 #endif /* _CTAGS_ENGINE_H */
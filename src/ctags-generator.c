@@ -0,0 +1,1091 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <glib/gstdio.h>
+#include "ctags-generator.h"
+#include "ctags-trace.h"
+#include "readtags.h"
+
+/*
+ * The generator runs ctags on a worker thread so that the main loop is 
+ * never blocked while a project is tagged. The new tags are written next 
+ * to the tag file, synced to disk and only then renamed over it, so 
+ * lookups keep reading the previous file, never a partly written one. 
+ * Only one job runs at a time; a job can be cancelled, which kills ctags 
+ * and leaves the tag file as it was. The "finished" signal is always 
+ * emitted on the main loop.
+ *
+ * A rebuild splits the source files into shards of about the same size, 
+ * one per processor, and runs a ctags process on each shard at once. The 
+ * sorted shards are then merged into the tag file in a single pass.
+ *
+ * An update skips the files whose content is the same as when they were 
+ * last tagged, going by a digest of each file taken as it is tagged, so 
+ * saving a file without changing it costs a read of the file. The digests 
+ * are kept next to the tag file for the next session, and are only 
+ * touched by the job running at the time.
+ */
+
+typedef struct
+{
+  CtagsGenerator *generator;
+  gchar          *file_path;
+  gchar          *folder_path;
+  GPtrArray      *source_folders;
+  GPtrArray      *file_paths;
+  GPtrArray      *shards;
+  GHashTable     *digests;
+  gchar          *digests_path;
+  gboolean        load_digests;
+  GMutex          mutex;
+  GPid            pid;
+  guint           files_tagged;
+  gboolean        cancelled;
+  gboolean        success;
+} Job;
+
+typedef struct
+{
+  gchar   *file_path;
+  goffset  size;
+} SourceFile;
+
+typedef struct
+{
+  Job        *job;
+  GString    *file_list;
+  gchar      *list_path;
+  gchar      *file_path;
+  GHashTable *digests;
+  goffset     size;
+  GPid        pid;
+  gboolean    success;
+} Shard;
+
+typedef struct
+{
+  GHashTable *file_paths;
+  GString    *file_path;
+} StaleTags;
+
+#define SHARD_SUFFIX ".shard"
+#define PARTIAL_SUFFIX ".partial"
+#define DIGESTS_SUFFIX ".digests"
+
+/* the fewest files worth a ctags process of their own */
+#define SHARD_FILES 256
+
+#define DIGEST_BUFFER 16384
+
+/* the default language maps of Exuberant Ctags, by extension or name */
+static const gchar *source_names[] = {
+  ".asm", ".ASM", ".s", ".S", ".A51", ".asp", ".asa", ".awk", ".gawk", ".mawk", 
+  ".bas", ".bi", ".bb", ".pb", ".bet", ".c", ".c++", ".cc", ".cp", ".cpp", 
+  ".cxx", ".h", ".h++", ".hh", ".hp", ".hpp", ".hxx", ".C", ".H", ".cs", 
+  ".cbl", ".cob", ".CBL", ".COB", ".bat", ".cmd", ".e", ".erl", ".ERL", 
+  ".hrl", ".HRL", ".as", ".mxml", ".f", ".for", ".ftn", ".f77", ".f90", 
+  ".f95", ".F", ".FOR", ".FTN", ".F77", ".F90", ".F95", ".htm", ".html", 
+  ".java", ".js", ".cl", ".clisp", ".el", ".l", ".lisp", ".lsp", ".lua", 
+  ".mak", ".mk", ".m", ".ml", ".mli", ".p", ".pas", ".pl", ".pm", ".plx", 
+  ".perl", ".php", ".php3", ".phtml", ".py", ".pyx", ".pxd", ".pxi", 
+  ".scons", ".rexx", ".rx", ".rb", ".ruby", ".SCM", ".SM", ".sch", 
+  ".scheme", ".scm", ".sm", ".sh", ".SH", ".bsh", ".bash", ".ksh", ".zsh", 
+  ".sl", ".sml", ".sig", ".sql", ".tcl", ".tk", ".wish", ".itcl", ".tex", 
+  ".vr", ".vri", ".vrh", ".v", ".vhdl", ".vhd", ".vim", ".y", 
+  "Makefile", "makefile", "GNUmakefile"
+};
+
+static void ctags_generator_class_init  (CtagsGeneratorClass *klass);
+static void ctags_generator_init        (CtagsGenerator      *generator);
+static void ctags_generator_finalize    (CtagsGenerator      *generator);
+
+static gboolean start_job               (CtagsGenerator      *generator,
+                                         GList               *source_folders,
+                                         GList               *file_paths);
+static GPtrArray* copy_list             (GList               *list);
+static gpointer run_job                 (Job                 *job);
+static gboolean rebuild_tags            (Job                 *job);
+static void collect_files               (Job                 *job,
+                                         const gchar         *folder_path,
+                                         GHashTable          *visited,
+                                         GArray              *source_files);
+static void create_shards               (Job                 *job,
+                                         GArray              *source_files);
+static gint compare_sizes               (const SourceFile    *source_file1,
+                                         const SourceFile    *source_file2);
+static gpointer run_shard               (Shard               *shard);
+static void free_shard                  (Shard               *shard);
+static gboolean update_tags             (Job                 *job);
+static void find_changes                (Job                 *job,
+                                         GPtrArray           *changed_paths,
+                                         GHashTable          *digests);
+static gchar* compute_digest            (const gchar         *file_path);
+static void store_digests               (Job                 *job,
+                                         GHashTable          *digests);
+static void load_digests                (Job                 *job);
+static void save_digests                (Job                 *job);
+static gboolean run_command             (Job                 *job, 
+                                         GPtrArray           *arguments,
+                                         GPid                *pid_slot);
+static void set_process_group          (gpointer             data);
+static gboolean is_cancelled            (Job                 *job);
+static gboolean verify_tags             (const gchar         *file_path);
+static gboolean sync_file               (const gchar         *file_path);
+static gboolean is_hidden               (const gchar         *name);
+static int exclude_shard_line           (const char *const    line,
+                                         const int            input,
+                                         void *const          data);
+static int exclude_stale_line           (const char *const    line,
+                                         const int            input,
+                                         void *const          data);
+static gboolean finish_job              (Job                 *job);
+static void free_job                    (Job                 *job);
+
+#define CTAGS_GENERATOR_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), CTAGS_GENERATOR_TYPE, CtagsGeneratorPrivate))
+
+typedef struct _CtagsGeneratorPrivate CtagsGeneratorPrivate;
+
+struct _CtagsGeneratorPrivate
+{
+  gchar      *file_path;
+  Job        *job;
+  GHashTable *digests;
+  gboolean    digests_loaded;
+  guint       files_tagged;
+};
+
+enum
+{
+  FINISHED,
+  LAST_SIGNAL
+};
+
+static guint ctags_generator_signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE (CtagsGenerator, ctags_generator, G_TYPE_OBJECT)
+
+static void 
+ctags_generator_class_init (CtagsGeneratorClass *klass)
+{
+  ctags_generator_signals[FINISHED] =
+    g_signal_new ("finished", 
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (CtagsGeneratorClass, finished),
+                  NULL, NULL, 
+                  g_cclosure_marshal_VOID__BOOLEAN, G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+
+  G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) ctags_generator_finalize;
+  g_type_class_add_private (klass, sizeof (CtagsGeneratorPrivate));
+}
+
+static void
+ctags_generator_init (CtagsGenerator *generator)
+{
+  CtagsGeneratorPrivate *priv;
+  priv = CTAGS_GENERATOR_GET_PRIVATE (generator);
+  priv->file_path = NULL;
+  priv->job = NULL;
+  priv->files_tagged = 0;
+  priv->digests_loaded = FALSE;
+  priv->digests = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void
+ctags_generator_finalize (CtagsGenerator *generator)
+{
+  CtagsGeneratorPrivate *priv;
+  priv = CTAGS_GENERATOR_GET_PRIVATE (generator);
+
+  if (priv->file_path != NULL)
+    g_free (priv->file_path);
+  
+  g_hash_table_destroy (priv->digests);
+      
+  G_OBJECT_CLASS (ctags_generator_parent_class)->finalize (G_OBJECT (generator));
+}
+
+CtagsGenerator*
+ctags_generator_new (const gchar *file_path)
+{
+  CtagsGenerator *generator;
+  generator = CTAGS_GENERATOR (g_object_new (ctags_generator_get_type (), NULL));
+  CTAGS_GENERATOR_GET_PRIVATE (generator)->file_path = g_strdup (file_path);
+  return generator;
+}
+
+/*
+ * Returns whether ctags would tag the file, going by its name alone.
+ */
+gboolean
+ctags_generator_is_source_file (const gchar *file_path)
+{
+  static gsize initialized = 0;
+  static GHashTable *names = NULL;
+  const gchar *name;
+  const gchar *extension;
+  
+  if (g_once_init_enter (&initialized))
+    {
+      guint i;
+      names = g_hash_table_new (g_str_hash, g_str_equal);
+      for (i = 0; i < G_N_ELEMENTS (source_names); i++)
+        g_hash_table_add (names, (gpointer) source_names[i]);
+      g_once_init_leave (&initialized, 1);
+    }
+  
+  name = strrchr (file_path, G_DIR_SEPARATOR);
+  name = name != NULL ? name + 1 : file_path;
+  
+  if (g_hash_table_contains (names, name))
+    return TRUE;
+  
+  extension = strrchr (name, '.');
+  return extension != NULL && extension != name && 
+         g_hash_table_contains (names, extension);
+}
+
+/*
+ * Tags the source folders from scratch into a new file which then 
+ * replaces the tag file. Returns FALSE if a job is already running.
+ */
+gboolean
+ctags_generator_rebuild (CtagsGenerator *generator,
+                         GList          *source_folders)
+{
+  return start_job (generator, source_folders, NULL);
+}
+
+/*
+ * Merges the tags of the changed files into the tag file, which must 
+ * exist. Returns FALSE if a job is already running.
+ */
+gboolean
+ctags_generator_update (CtagsGenerator *generator,
+                        GList          *file_paths)
+{
+  return start_job (generator, NULL, file_paths);
+}
+
+gboolean
+ctags_generator_is_running (CtagsGenerator *generator)
+{
+  return CTAGS_GENERATOR_GET_PRIVATE (generator)->job != NULL;
+}
+
+/*
+ * Returns the number of files the last job handed to ctags.
+ */
+guint
+ctags_generator_get_files_tagged (CtagsGenerator *generator)
+{
+  return CTAGS_GENERATOR_GET_PRIVATE (generator)->files_tagged;
+}
+
+/*
+ * Stops the running job, if any, without touching the tag file. The 
+ * job still finishes through the "finished" signal, as a failure.
+ */
+void
+ctags_generator_cancel (CtagsGenerator *generator)
+{
+  CtagsGeneratorPrivate *priv;
+  Job *job;
+  
+  priv = CTAGS_GENERATOR_GET_PRIVATE (generator);
+  
+  job = priv->job;
+  if (job == NULL)
+    return;
+  
+  g_mutex_lock (&job->mutex);
+  
+  job->cancelled = TRUE;
+  if (job->pid != 0)
+    kill (-job->pid, SIGTERM);
+  
+  if (job->shards != NULL)
+    {
+      guint i;
+      for (i = 0; i < job->shards->len; i++)
+        {
+          Shard *shard = g_ptr_array_index (job->shards, i);
+          if (shard->pid != 0)
+            kill (-shard->pid, SIGTERM);
+        }
+    }
+  
+  g_mutex_unlock (&job->mutex);
+}
+
+/*
+ * Starts a rebuild if given the source folders, otherwise an update.
+ */
+static gboolean
+start_job (CtagsGenerator *generator,
+           GList          *source_folders,
+           GList          *file_paths)
+{
+  CtagsGeneratorPrivate *priv;
+  GThread *thread;
+  Job *job;
+  
+  priv = CTAGS_GENERATOR_GET_PRIVATE (generator);
+  
+  if (priv->job != NULL)
+    return FALSE;
+  
+  job = g_slice_new0 (Job);
+  job->generator = g_object_ref (generator);
+  job->file_path = g_strdup (priv->file_path);
+  job->folder_path = g_path_get_dirname (priv->file_path);
+  job->digests = priv->digests;
+  job->digests_path = g_strconcat (priv->file_path, DIGESTS_SUFFIX, NULL);
+  job->load_digests = !priv->digests_loaded;
+  priv->digests_loaded = TRUE;
+  g_mutex_init (&job->mutex);
+  
+  if (source_folders != NULL)
+    job->source_folders = copy_list (source_folders);
+  else
+    job->file_paths = copy_list (file_paths);
+  
+  priv->job = job;
+  
+  thread = g_thread_new ("ctags", (GThreadFunc) run_job, job);
+  g_thread_unref (thread);
+  
+  return TRUE;
+}
+
+static GPtrArray*
+copy_list (GList *list)
+{
+  GPtrArray *array;
+  array = g_ptr_array_new_with_free_func (g_free);
+  while (list != NULL)
+    {
+      g_ptr_array_add (array, g_strdup (list->data));
+      list = g_list_next (list);
+    }
+  return array;
+}
+
+/*
+ * Runs on the worker thread, which only ever touches the job itself.
+ */
+static gpointer
+run_job (Job *job)
+{
+  if (job->load_digests)
+    load_digests (job);
+  
+  /* the digests on disk would be stale if the job died half way */
+  g_remove (job->digests_path);
+  
+  if (job->source_folders != NULL)
+    job->success = rebuild_tags (job);
+  else
+    job->success = update_tags (job);
+  
+  if (job->success)
+    save_digests (job);
+  
+  g_idle_add ((GSourceFunc) finish_job, job);
+  
+  return NULL;
+}
+
+/*
+ * Tags and sorts the shards on threads of their own, then merges them.
+ */
+static gboolean
+rebuild_tags (Job *job)
+{
+  GHashTable *visited;
+  GArray *source_files;
+  GPtrArray *shards;
+  GThread **threads;
+  const gchar **inputs;
+  gboolean result = TRUE;
+  guint i;
+  
+  /* the shards record the digests of the files they tag */
+  g_hash_table_remove_all (job->digests);
+  
+  visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  source_files = g_array_new (FALSE, FALSE, sizeof (SourceFile));
+  
+  for (i = 0; i < job->source_folders->len; i++)
+    collect_files (job, g_ptr_array_index (job->source_folders, i), 
+                   visited, source_files);
+  
+  g_hash_table_destroy (visited);
+  
+  job->files_tagged = source_files->len;
+  
+  if (is_cancelled (job))
+    result = FALSE;
+  else
+    create_shards (job, source_files);
+  
+  for (i = 0; i < source_files->len; i++)
+    g_free (g_array_index (source_files, SourceFile, i).file_path);
+  g_array_free (source_files, TRUE);
+  
+  if (!result)
+    return FALSE;
+
+  shards = job->shards;
+  threads = g_new (GThread*, shards->len);
+  
+  for (i = 0; i < shards->len; i++)
+    threads[i] = g_thread_new ("ctags-shard", (GThreadFunc) run_shard, 
+                               g_ptr_array_index (shards, i));
+  
+  for (i = 0; i < shards->len; i++)
+    {
+      Shard *shard = g_ptr_array_index (shards, i);
+      g_thread_join (threads[i]);
+      result = result && shard->success;
+    }
+  
+  g_free (threads);
+  
+  if (result && !is_cancelled (job))
+    {
+      if (shards->len == 1)
+        {
+          Shard *shard = g_ptr_array_index (shards, 0);
+          result = sync_file (shard->file_path) && 
+                   g_rename (shard->file_path, job->file_path) == 0;
+        }
+      else
+        {
+          inputs = g_new (const gchar*, shards->len);
+          for (i = 0; i < shards->len; i++)
+            inputs[i] = ((Shard*) g_ptr_array_index (shards, i))->file_path;
+          result = tagsMergeFiles (inputs, shards->len, job->file_path, 
+                                   exclude_shard_line, NULL) == TagSuccess;
+          g_free (inputs);
+        }
+    }
+  else
+    {
+      result = FALSE;
+    }
+  
+  for (i = 0; result && i < shards->len; i++)
+    store_digests (job, ((Shard*) g_ptr_array_index (shards, i))->digests);
+  
+  g_mutex_lock (&job->mutex);
+  job->shards = NULL;
+  g_mutex_unlock (&job->mutex);
+  
+  g_ptr_array_foreach (shards, (GFunc) free_shard, NULL);
+  g_ptr_array_free (shards, TRUE);
+  
+  return result;
+}
+
+/*
+ * Follows links like ctags does, skipping folders already visited.
+ */
+static void
+collect_files (Job         *job,
+               const gchar *folder_path,
+               GHashTable  *visited,
+               GArray      *source_files)
+{
+  GStatBuf stat_buf;
+  const gchar *name;
+  gchar *key;
+  GDir *dir;
+  
+  if (g_stat (folder_path, &stat_buf) != 0 || is_cancelled (job))
+    return;
+  
+  key = g_strdup_printf ("%lu:%lu", (gulong) stat_buf.st_dev, 
+                         (gulong) stat_buf.st_ino);
+  if (g_hash_table_lookup_extended (visited, key, NULL, NULL))
+    {
+      g_free (key);
+      return;
+    }
+  g_hash_table_insert (visited, key, NULL);
+  
+  dir = g_dir_open (folder_path, 0, NULL);
+  if (dir == NULL)
+    return;
+  
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      gchar *file_path = g_build_filename (folder_path, name, NULL);
+      
+      if (g_stat (file_path, &stat_buf) != 0)
+        {
+          g_free (file_path);
+        }
+      else if (S_ISDIR (stat_buf.st_mode))
+        {
+          if (!is_hidden (name))
+            collect_files (job, file_path, visited, source_files);
+          g_free (file_path);
+        }
+      else if (S_ISREG (stat_buf.st_mode) && ctags_generator_is_source_file (file_path))
+        {
+          SourceFile source_file;
+          source_file.file_path = file_path;
+          source_file.size = stat_buf.st_size;
+          g_array_append_val (source_files, source_file);
+        }
+      else
+        {
+          g_free (file_path);
+        }
+    }
+  
+  g_dir_close (dir);
+}
+
+/*
+ * Deals the files out largest first, each to the shard with the fewest bytes.
+ */
+static void
+create_shards (Job    *job,
+               GArray *source_files)
+{
+  GPtrArray *shards;
+  glong processors;
+  guint count;
+  guint i;
+  
+  processors = sysconf (_SC_NPROCESSORS_ONLN);
+  if (processors < 1)
+    processors = 1;
+  
+  count = (source_files->len + SHARD_FILES - 1) / SHARD_FILES;
+  count = CLAMP (count, 1, (guint) processors);
+  
+  shards = g_ptr_array_new ();
+  for (i = 0; i < count; i++)
+    {
+      Shard *shard = g_slice_new0 (Shard);
+      shard->job = job;
+      shard->file_list = g_string_new (NULL);
+      shard->file_path = g_strdup_printf ("%s%s%u", job->file_path, SHARD_SUFFIX, i);
+      shard->list_path = g_strconcat (shard->file_path, ".list", NULL);
+      shard->digests = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+      g_ptr_array_add (shards, shard);
+    }
+  
+  g_array_sort (source_files, (GCompareFunc) compare_sizes);
+  
+  for (i = 0; i < source_files->len; i++)
+    {
+      SourceFile *source_file = &g_array_index (source_files, SourceFile, i);
+      Shard *smallest = g_ptr_array_index (shards, 0);
+      guint j;
+      
+      for (j = 1; j < count; j++)
+        {
+          Shard *shard = g_ptr_array_index (shards, j);
+          if (shard->size < smallest->size)
+            smallest = shard;
+        }
+      
+      g_string_append (smallest->file_list, source_file->file_path);
+      g_string_append_c (smallest->file_list, '\n');
+      smallest->size += source_file->size;
+    }
+  
+  g_mutex_lock (&job->mutex);
+  job->shards = shards;
+  g_mutex_unlock (&job->mutex);
+}
+
+static gint
+compare_sizes (const SourceFile *source_file1,
+               const SourceFile *source_file2)
+{
+  if (source_file1->size > source_file2->size)
+    return -1;
+  return source_file1->size < source_file2->size;
+}
+
+static gpointer
+run_shard (Shard *shard)
+{
+  GPtrArray *arguments;
+  gchar **file_paths;
+  gchar **file_path;
+  
+  if (!g_file_set_contents (shard->list_path, shard->file_list->str, 
+                            shard->file_list->len, NULL))
+    return NULL;
+  
+  /* taken before ctags reads the files, so a later change is not missed */
+  file_paths = g_strsplit (shard->file_list->str, "\n", -1);
+  for (file_path = file_paths; *file_path != NULL; file_path++)
+    if (**file_path != '\0')
+      g_hash_table_insert (shard->digests, g_strdup (*file_path), 
+                           compute_digest (*file_path));
+  g_strfreev (file_paths);
+  
+  arguments = g_ptr_array_new ();
+  g_ptr_array_add (arguments, "ctags");
+  g_ptr_array_add (arguments, "--fields=n");
+  g_ptr_array_add (arguments, "-f");
+  g_ptr_array_add (arguments, shard->file_path);
+  g_ptr_array_add (arguments, "-L");
+  g_ptr_array_add (arguments, shard->list_path);
+  
+  shard->success = run_command (shard->job, arguments, &shard->pid) && 
+                   !is_cancelled (shard->job) && 
+                   verify_tags (shard->file_path);
+  
+  g_ptr_array_free (arguments, TRUE);
+  
+  return NULL;
+}
+
+static void
+free_shard (Shard *shard)
+{
+  g_remove (shard->list_path);
+  g_remove (shard->file_path);
+  g_string_free (shard->file_list, TRUE);
+  g_hash_table_destroy (shard->digests);
+  g_free (shard->list_path);
+  g_free (shard->file_path);
+  g_slice_free (Shard, shard);
+}
+
+static gboolean
+update_tags (Job *job)
+{
+  GPtrArray *arguments;
+  GPtrArray *changed_paths;
+  GHashTable *digests;
+  StaleTags stale_tags;
+  const gchar *inputs[2];
+  gchar *partial_file_path;
+  gchar *list_path;
+  GString *file_list;
+  gboolean result = FALSE;
+  guint i;
+  
+  if (job->file_paths->len == 0)
+    return TRUE;
+  
+  if (!g_file_test (job->file_path, G_FILE_TEST_EXISTS))
+    return FALSE;
+  
+  changed_paths = g_ptr_array_new ();
+  digests = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+  
+  find_changes (job, changed_paths, digests);
+  job->files_tagged = changed_paths->len;
+  
+  if (changed_paths->len == 0)
+    {
+      g_ptr_array_free (changed_paths, TRUE);
+      g_hash_table_destroy (digests);
+      return TRUE;
+    }
+  
+  partial_file_path = g_strconcat (job->file_path, PARTIAL_SUFFIX, NULL);
+  list_path = g_strconcat (partial_file_path, ".list", NULL);
+  
+  file_list = g_string_new (NULL);
+  for (i = 0; i < changed_paths->len; i++)
+    {
+      g_string_append (file_list, g_ptr_array_index (changed_paths, i));
+      g_string_append_c (file_list, '\n');
+    }
+  
+  arguments = g_ptr_array_new ();
+  g_ptr_array_add (arguments, "ctags");
+  g_ptr_array_add (arguments, "--fields=n");
+  g_ptr_array_add (arguments, "-f");
+  g_ptr_array_add (arguments, partial_file_path);
+  g_ptr_array_add (arguments, "-L");
+  g_ptr_array_add (arguments, list_path);
+  
+  if (g_file_set_contents (list_path, file_list->str, file_list->len, NULL) && 
+      run_command (job, arguments, &job->pid) && 
+      !is_cancelled (job) && 
+      verify_tags (partial_file_path))
+    {
+      inputs[0] = job->file_path;
+      inputs[1] = partial_file_path;
+      stale_tags.file_paths = digests;
+      stale_tags.file_path = g_string_new (NULL);
+      result = tagsMergeFiles (inputs, 2, job->file_path, 
+                               exclude_stale_line, &stale_tags) == TagSuccess;
+      g_string_free (stale_tags.file_path, TRUE);
+    }
+  
+  if (result)
+    store_digests (job, digests);
+  
+  g_remove (list_path);
+  g_remove (partial_file_path);
+  
+  g_ptr_array_free (arguments, TRUE);
+  g_ptr_array_free (changed_paths, TRUE);
+  g_hash_table_destroy (digests);
+  g_string_free (file_list, TRUE);
+  g_free (list_path);
+  g_free (partial_file_path);
+  
+  return result;
+}
+
+/*
+ * Unreadable files are still tagged, which drops their tags.
+ */
+static void
+find_changes (Job        *job,
+              GPtrArray  *changed_paths,
+              GHashTable *digests)
+{
+  guint i;
+  
+  for (i = 0; i < job->file_paths->len; i++)
+    {
+      gchar *file_path = g_ptr_array_index (job->file_paths, i);
+      gchar *digest = compute_digest (file_path);
+      
+      if (digest != NULL && 
+          g_strcmp0 (g_hash_table_lookup (job->digests, file_path), digest) == 0)
+        {
+          g_free (digest);
+          continue;
+        }
+      
+      g_ptr_array_add (changed_paths, file_path);
+      g_hash_table_insert (digests, file_path, digest);
+    }
+}
+
+static gchar*
+compute_digest (const gchar *file_path)
+{
+  GChecksum *checksum;
+  guchar buffer[DIGEST_BUFFER];
+  gchar *digest = NULL;
+  gsize length;
+  FILE *file;
+  
+  file = g_fopen (file_path, "rb");
+  if (file == NULL)
+    return NULL;
+  
+  checksum = g_checksum_new (G_CHECKSUM_MD5);
+  
+  while ((length = fread (buffer, 1, sizeof (buffer), file)) > 0)
+    g_checksum_update (checksum, buffer, length);
+  
+  if (!ferror (file))
+    digest = g_strdup (g_checksum_get_string (checksum));
+  
+  g_checksum_free (checksum);
+  fclose (file);
+  
+  return digest;
+}
+
+static void
+store_digests (Job        *job,
+               GHashTable *digests)
+{
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  
+  g_hash_table_iter_init (&iter, digests);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      if (value != NULL)
+        g_hash_table_replace (job->digests, g_strdup (key), g_strdup (value));
+      else
+        g_hash_table_remove (job->digests, key);
+    }
+}
+
+/*
+ * Reads the digests left by the last session, one "digest path" per line.
+ */
+static void
+load_digests (Job *job)
+{
+  gchar *contents;
+  gchar **lines;
+  gchar **line;
+  
+  if (!g_file_get_contents (job->digests_path, &contents, NULL, NULL))
+    return;
+  
+  lines = g_strsplit (contents, "\n", -1);
+  for (line = lines; *line != NULL; line++)
+    {
+      gchar *separator = strchr (*line, ' ');
+      if (separator == NULL)
+        continue;
+      *separator = '\0';
+      g_hash_table_replace (job->digests, g_strdup (separator + 1), g_strdup (*line));
+    }
+  
+  g_strfreev (lines);
+  g_free (contents);
+}
+
+static void
+save_digests (Job *job)
+{
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  GString *contents;
+  
+  contents = g_string_new (NULL);
+  
+  g_hash_table_iter_init (&iter, job->digests);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      if (strchr (key, '\n') != NULL)
+        continue;
+      g_string_append_printf (contents, "%s %s\n", (gchar *) value, (gchar *) key);
+    }
+  
+  g_file_set_contents (job->digests_path, contents->str, contents->len, NULL);
+  g_string_free (contents, TRUE);
+}
+
+/*
+ * ctags leads its own process group, reaped only once its pid is cleared.
+ */
+static gboolean
+run_command (Job       *job, 
+             GPtrArray *arguments,
+             GPid      *pid_slot)
+{
+  GError *error = NULL;
+  siginfo_t info;
+  gint64 trace_time;
+  gint status;
+  GPid pid;
+  
+  g_ptr_array_add (arguments, NULL);
+  trace_time = ctags_trace_now ();
+  
+  g_mutex_lock (&job->mutex);
+  
+  if (job->cancelled || 
+      !g_spawn_async (job->folder_path, (gchar **) arguments->pdata, NULL,
+                      G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD |
+                      G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+                      set_process_group, NULL, &pid, &error))
+    {
+      g_mutex_unlock (&job->mutex);
+      g_ptr_array_remove_index (arguments, arguments->len - 1);
+      if (error != NULL)
+        {
+          g_warning ("Could not run ctags: %s", error->message);
+          g_error_free (error);
+        }
+      return FALSE;
+    }
+  
+  *pid_slot = pid;
+  g_mutex_unlock (&job->mutex);
+  g_ptr_array_remove_index (arguments, arguments->len - 1);
+  
+  while (waitid (P_PID, pid, &info, WEXITED | WNOWAIT) != 0 && errno == EINTR);
+  
+  g_mutex_lock (&job->mutex);
+  *pid_slot = 0;
+  g_mutex_unlock (&job->mutex);
+  
+  while (waitpid (pid, &status, 0) < 0 && errno == EINTR);
+  g_spawn_close_pid (pid);
+  
+  if (trace_time != 0)
+    {
+      gchar *detail = g_strdup_printf ("pid %d, status %d", (gint) pid, status);
+      ctags_trace_span ("ctags", "ctags", trace_time, detail);
+      g_free (detail);
+    }
+  
+  return WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+static void
+set_process_group (gpointer data)
+{
+  setpgid (0, 0);
+}
+
+static gboolean
+is_cancelled (Job *job)
+{
+  gboolean cancelled;
+  g_mutex_lock (&job->mutex);
+  cancelled = job->cancelled;
+  g_mutex_unlock (&job->mutex);
+  return cancelled;
+}
+
+/*
+ * Sorts the file in C locale order if ctags left it otherwise.
+ */
+static gboolean
+verify_tags (const gchar *file_path)
+{
+  tagFileInfo info;
+  tagFile *tag_file;
+  
+  tag_file = tagsOpen (file_path, &info);
+  if (tag_file == NULL)
+    return FALSE;
+  
+  tagsVerifySort (tag_file, &info);
+  tagsClose (tag_file);
+  
+  if (info.file.actualSort != TAG_SORTED && 
+      tagsSortFile (file_path, file_path, 0) != TagSuccess)
+    {
+      g_warning ("Could not sort the tags file");
+      return FALSE;
+    }
+  
+  return TRUE;
+}
+
+static gboolean
+sync_file (const gchar *file_path)
+{
+  gboolean result;
+  int fd;
+  
+  fd = g_open (file_path, O_RDONLY, 0);
+  if (fd < 0)
+    return FALSE;
+  
+  result = fsync (fd) == 0;
+  close (fd);
+  
+  return result;
+}
+
+/*
+ * Hidden folders, such as those of version control, are skipped like the 
+ * watcher does.
+ */
+static gboolean
+is_hidden (const gchar *name)
+{
+  return name[0] == '.';
+}
+
+/*
+ * Keeps the pseudo tags of the first shard only.
+ */
+static int
+exclude_shard_line (const char *const  line,
+                    const int          input,
+                    void *const        data)
+{
+  return input > 0 && g_str_has_prefix (line, "!_");
+}
+
+/*
+ * Leaves out the old tags of the changed files and the repeated pseudo tags.
+ */
+static int
+exclude_stale_line (const char *const  line,
+                    const int          input,
+                    void *const        data)
+{
+  StaleTags *stale_tags = data;
+  const char *file_path;
+  const char *end;
+  
+  if (g_str_has_prefix (line, "!_"))
+    return input == 1;
+  
+  if (input == 1)
+    return FALSE;
+
+  file_path = strchr (line, '\t');
+  if (file_path == NULL)
+    return FALSE;
+  
+  file_path++;
+  end = strchr (file_path, '\t');
+  if (end == NULL)
+    return FALSE;
+  
+  g_string_truncate (stale_tags->file_path, 0);
+  g_string_append_len (stale_tags->file_path, file_path, end - file_path);
+  
+  return g_hash_table_contains (stale_tags->file_paths, stale_tags->file_path->str);
+}
+
+/*
+ * Back on the main loop once the worker thread is done with the job.
+ */
+static gboolean
+finish_job (Job *job)
+{
+  CtagsGenerator *generator = job->generator;
+  gboolean success;
+  
+  CTAGS_GENERATOR_GET_PRIVATE (generator)->job = NULL;
+  CTAGS_GENERATOR_GET_PRIVATE (generator)->files_tagged = job->files_tagged;
+  
+  success = job->success && !job->cancelled;
+  free_job (job);
+  
+  g_signal_emit_by_name ((gpointer) generator, "finished", success);
+  g_object_unref (generator);
+  
+  return FALSE;
+}
+
+static void
+free_job (Job *job)
+{
+  if (job->source_folders != NULL)
+    g_ptr_array_free (job->source_folders, TRUE);
+  if (job->file_paths != NULL)
+    g_ptr_array_free (job->file_paths, TRUE);
+  g_mutex_clear (&job->mutex);
+  g_free (job->digests_path);
+  g_free (job->file_path);
+  g_free (job->folder_path);
+  g_slice_free (Job, job);
+}
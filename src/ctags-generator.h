@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __CTAGS_GENERATOR_H__
+#define	__CTAGS_GENERATOR_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define CTAGS_GENERATOR_TYPE            (ctags_generator_get_type ())
+#define CTAGS_GENERATOR(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), CTAGS_GENERATOR_TYPE, CtagsGenerator))
+#define CTAGS_GENERATOR_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), CTAGS_GENERATOR_TYPE, CtagsGeneratorClass))
+#define IS_CTAGS_GENERATOR(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), CTAGS_GENERATOR_TYPE))
+#define IS_CTAGS_GENERATOR_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), CTAGS_GENERATOR_TYPE))
+
+typedef struct _CtagsGenerator CtagsGenerator;
+typedef struct _CtagsGeneratorClass CtagsGeneratorClass;
+
+struct _CtagsGenerator
+{
+  GObject parent_instance;
+};
+
+struct _CtagsGeneratorClass
+{
+  GObjectClass parent_class;
+  
+  void (*finished) (CtagsGenerator *generator, gboolean success);
+};
+
+GType ctags_generator_get_type (void) G_GNUC_CONST;
+
+CtagsGenerator*  ctags_generator_new               (const gchar    *file_path);
+
+gboolean         ctags_generator_rebuild           (CtagsGenerator *generator,
+                                                    GList          *source_folders);
+gboolean         ctags_generator_update            (CtagsGenerator *generator,
+                                                    GList          *file_paths);
+gboolean         ctags_generator_is_running        (CtagsGenerator *generator);
+gboolean         ctags_generator_is_source_file    (const gchar    *file_path);
+guint            ctags_generator_get_files_tagged  (CtagsGenerator *generator);
+void             ctags_generator_cancel            (CtagsGenerator *generator);
+
+G_END_DECLS
+
+#endif /* __CTAGS_GENERATOR_H__ */
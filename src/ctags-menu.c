@@ -18,6 +18,7 @@
 #include <gdk/gdkkeysyms.h>
 #include <codeslayer/codeslayer.h>
 #include "ctags-menu.h"
+#include "ctags-trace.h"
 
 static void ctags_menu_class_init  (CtagsMenuClass *klass);
 static void ctags_menu_init        (CtagsMenu      *menu);
@@ -27,14 +28,25 @@ static void add_menu_items         (CtagsMenu      *menu,
                                     GtkWidget      *submenu,
                                     GtkAccelGroup  *accel_group);
 static void find_tag_action        (CtagsMenu      *menu);
+static void find_tag_ignore_case_action (CtagsMenu *menu);
+static void find_symbol_action     (CtagsMenu      *menu);
+static void rebuild_tags_action    (CtagsMenu      *menu);
 static void previous_action        (CtagsMenu      *menu);
 static void next_action            (CtagsMenu      *menu);
+static void show_statistics_action (CtagsMenu      *menu);
+static void trace_action           (CtagsMenu        *menu,
+                                    GtkCheckMenuItem *item);
                                         
 enum
 {
   FIND_TAG,
+  FIND_TAG_IGNORE_CASE,
+  FIND_SYMBOL,
+  REBUILD_TAGS,
   PREVIOUS,
   NEXT,
+  SHOW_STATISTICS,
+  TRACE,
   LAST_SIGNAL
 };
 
@@ -53,6 +65,30 @@ ctags_menu_class_init (CtagsMenuClass *klass)
                   NULL, NULL, 
                   g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
 
+  ctags_menu_signals[FIND_TAG_IGNORE_CASE] =
+    g_signal_new ("find-tag-ignore-case", 
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (CtagsMenuClass, find_tag_ignore_case),
+                  NULL, NULL, 
+                  g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  ctags_menu_signals[FIND_SYMBOL] =
+    g_signal_new ("find-symbol", 
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (CtagsMenuClass, find_symbol),
+                  NULL, NULL, 
+                  g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  ctags_menu_signals[REBUILD_TAGS] =
+    g_signal_new ("rebuild-tags", 
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (CtagsMenuClass, rebuild_tags),
+                  NULL, NULL, 
+                  g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
   ctags_menu_signals[PREVIOUS] =
     g_signal_new ("previous", 
                   G_TYPE_FROM_CLASS (klass),
@@ -69,6 +105,22 @@ ctags_menu_class_init (CtagsMenuClass *klass)
                   NULL, NULL, 
                   g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
 
+  ctags_menu_signals[SHOW_STATISTICS] =
+    g_signal_new ("show-statistics", 
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (CtagsMenuClass, show_statistics),
+                  NULL, NULL, 
+                  g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  ctags_menu_signals[TRACE] =
+    g_signal_new ("trace", 
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (CtagsMenuClass, trace),
+                  NULL, NULL, 
+                  g_cclosure_marshal_VOID__BOOLEAN, G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+
   G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) ctags_menu_finalize;
 }
 
@@ -106,14 +158,29 @@ add_menu_items (CtagsMenu     *menu,
                 GtkAccelGroup *accel_group)
 {
   GtkWidget *find_item;
+  GtkWidget *find_ignore_case_item;
+  GtkWidget *find_symbol_item;
   GtkWidget *previous_item;
   GtkWidget *next_item;
+  GtkWidget *rebuild_item;
+  GtkWidget *statistics_item;
+  GtkWidget *trace_item;
 
   find_item = codeslayer_menu_item_new_with_label (_("Find Tag"));
   gtk_widget_add_accelerator (find_item, "activate", accel_group, 
                               GDK_KEY_F4, 0, GTK_ACCEL_VISIBLE);  
   gtk_menu_shell_append (GTK_MENU_SHELL (submenu), find_item);
 
+  find_ignore_case_item = codeslayer_menu_item_new_with_label (_("Find Tag Ignore Case"));
+  gtk_widget_add_accelerator (find_ignore_case_item, "activate", accel_group, 
+                              GDK_KEY_F4, GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);  
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), find_ignore_case_item);
+
+  find_symbol_item = codeslayer_menu_item_new_with_label (_("Find Symbol"));
+  gtk_widget_add_accelerator (find_symbol_item, "activate", accel_group, 
+                              GDK_KEY_F4, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);  
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), find_symbol_item);
+
   previous_item = codeslayer_menu_item_new_with_label (_("Previous"));
   gtk_widget_add_accelerator (previous_item, "activate", accel_group, 
                               GDK_KEY_Left, GDK_MOD1_MASK, GTK_ACCEL_VISIBLE); 
@@ -123,15 +190,42 @@ add_menu_items (CtagsMenu     *menu,
   gtk_widget_add_accelerator (next_item, "activate", accel_group, 
                               GDK_KEY_Right, GDK_MOD1_MASK, GTK_ACCEL_VISIBLE);
   gtk_menu_shell_append (GTK_MENU_SHELL (submenu), next_item);
+
+  rebuild_item = codeslayer_menu_item_new_with_label (_("Rebuild Tags"));
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), rebuild_item);
+  
+  statistics_item = codeslayer_menu_item_new_with_label (_("Ctags Statistics"));
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), statistics_item);
+  
+  /* a trace may have been started from the environment */
+  trace_item = gtk_check_menu_item_new_with_label (_("Trace Activity"));
+  gtk_check_menu_item_set_active (GTK_CHECK_MENU_ITEM (trace_item), 
+                                  ctags_trace_is_running ());
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), trace_item);
   
   g_signal_connect_swapped (G_OBJECT (find_item), "activate", 
                             G_CALLBACK (find_tag_action), menu);
 
+  g_signal_connect_swapped (G_OBJECT (find_ignore_case_item), "activate", 
+                            G_CALLBACK (find_tag_ignore_case_action), menu);
+
+  g_signal_connect_swapped (G_OBJECT (find_symbol_item), "activate", 
+                            G_CALLBACK (find_symbol_action), menu);
+
   g_signal_connect_swapped (G_OBJECT (previous_item), "activate", 
                             G_CALLBACK (previous_action), menu);
    
   g_signal_connect_swapped (G_OBJECT (next_item), "activate", 
                             G_CALLBACK (next_action), menu);
+
+  g_signal_connect_swapped (G_OBJECT (rebuild_item), "activate", 
+                            G_CALLBACK (rebuild_tags_action), menu);
+
+  g_signal_connect_swapped (G_OBJECT (statistics_item), "activate", 
+                            G_CALLBACK (show_statistics_action), menu);
+
+  g_signal_connect_swapped (G_OBJECT (trace_item), "toggled", 
+                            G_CALLBACK (trace_action), menu);
 }
 
 static void 
@@ -140,6 +234,18 @@ find_tag_action (CtagsMenu *menu)
   g_signal_emit_by_name ((gpointer) menu, "find-tag");
 }
 
+static void 
+find_tag_ignore_case_action (CtagsMenu *menu) 
+{
+  g_signal_emit_by_name ((gpointer) menu, "find-tag-ignore-case");
+}
+
+static void 
+find_symbol_action (CtagsMenu *menu) 
+{
+  g_signal_emit_by_name ((gpointer) menu, "find-symbol");
+}
+
 static void 
 previous_action (CtagsMenu *menu) 
 {
@@ -151,3 +257,35 @@ next_action (CtagsMenu *menu)
 {
   g_signal_emit_by_name ((gpointer) menu, "next");
 }
+
+static void 
+rebuild_tags_action (CtagsMenu *menu) 
+{
+  g_signal_emit_by_name ((gpointer) menu, "rebuild-tags");
+}
+
+static void 
+show_statistics_action (CtagsMenu *menu) 
+{
+  g_signal_emit_by_name ((gpointer) menu, "show-statistics");
+}
+
+/*
+ * The item is unchecked again, without asking for another change, when 
+ * the trace could not be started.
+ */
+static void 
+trace_action (CtagsMenu        *menu,
+              GtkCheckMenuItem *item) 
+{
+  gboolean active = gtk_check_menu_item_get_active (item);
+  
+  g_signal_emit_by_name ((gpointer) menu, "trace", active);
+  
+  if (active && !ctags_trace_is_running ())
+    {
+      g_signal_handlers_block_by_func (item, trace_action, menu);
+      gtk_check_menu_item_set_active (item, FALSE);
+      g_signal_handlers_unblock_by_func (item, trace_action, menu);
+    }
+}
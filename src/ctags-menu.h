@@ -42,8 +42,13 @@ struct _CtagsMenuClass
   GtkMenuItemClass parent_class;
 
   void (*find_tag) (CtagsMenu *menu);
+  void (*find_tag_ignore_case) (CtagsMenu *menu);
+  void (*find_symbol) (CtagsMenu *menu);
+  void (*rebuild_tags) (CtagsMenu *menu);
   void (*previous) (CtagsMenu *menu);
   void (*next) (CtagsMenu *menu);
+  void (*show_statistics) (CtagsMenu *menu);
+  void (*trace) (CtagsMenu *menu, gboolean active);
 };
 
 GType ctags_menu_get_type (void) G_GNUC_CONST;
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "ctags-name-index.h"
+
+/*
+ * The distinct tag names of one generation of a tag file, kept in sorted 
+ * order in a single string chunk. Every name sharing a prefix sits in one
+ * contiguous run, so two binary searches give both the number of names 
+ * with the prefix and the names themselves, without touching the tag file 
+ * or walking the individual tags.
+ */
+
+static void ctags_name_index_class_init  (CtagsNameIndexClass *klass);
+static void ctags_name_index_init        (CtagsNameIndex      *index);
+static void ctags_name_index_finalize    (CtagsNameIndex      *index);
+
+static void load_names                   (CtagsNameIndex      *index, 
+                                          tagFile             *tag_file);
+static gint compare_names                (gconstpointer        a, 
+                                          gconstpointer        b);
+
+#define CTAGS_NAME_INDEX_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), CTAGS_NAME_INDEX_TYPE, CtagsNameIndexPrivate))
+
+typedef struct _CtagsNameIndexPrivate CtagsNameIndexPrivate;
+
+struct _CtagsNameIndexPrivate
+{
+  GStringChunk *chunk;
+  GPtrArray    *names;
+};
+
+G_DEFINE_TYPE (CtagsNameIndex, ctags_name_index, G_TYPE_OBJECT)
+
+static void 
+ctags_name_index_class_init (CtagsNameIndexClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) ctags_name_index_finalize;
+  g_type_class_add_private (klass, sizeof (CtagsNameIndexPrivate));
+}
+
+static void
+ctags_name_index_init (CtagsNameIndex *index)
+{
+  CtagsNameIndexPrivate *priv;
+  priv = CTAGS_NAME_INDEX_GET_PRIVATE (index);
+  priv->chunk = g_string_chunk_new (64 * 1024);
+  priv->names = g_ptr_array_new ();
+}
+
+static void
+ctags_name_index_finalize (CtagsNameIndex *index)
+{
+  CtagsNameIndexPrivate *priv;
+  priv = CTAGS_NAME_INDEX_GET_PRIVATE (index);
+  g_ptr_array_free (priv->names, TRUE);
+  g_string_chunk_free (priv->chunk);
+  G_OBJECT_CLASS (ctags_name_index_parent_class)->finalize (G_OBJECT (index));
+}
+
+/*
+ * Builds the index with a single pass over the tag file. The entries are
+ * not parsed, only their names are read.
+ */
+CtagsNameIndex*
+ctags_name_index_new (tagFile *tag_file)
+{
+  CtagsNameIndex *index;
+  index = CTAGS_NAME_INDEX (g_object_new (ctags_name_index_get_type (), NULL));
+  load_names (index, tag_file);
+  return index;
+}
+
+static void
+load_names (CtagsNameIndex *index, 
+            tagFile        *tag_file)
+{
+  CtagsNameIndexPrivate *priv;
+  gboolean sorted = TRUE;
+  const gchar *last = NULL;
+  const gchar *name;
+  
+  priv = CTAGS_NAME_INDEX_GET_PRIVATE (index);
+  
+  if (tagsFirst (tag_file, NULL) != TagSuccess)
+    return;
+  
+  do
+    {
+      gint comparison;
+      name = tagsName (tag_file);
+      comparison = last != NULL ? strcmp (last, name) : -1;
+      if (comparison == 0)
+        continue;
+      if (comparison > 0)
+        sorted = FALSE;
+      last = g_string_chunk_insert (priv->chunk, name);
+      g_ptr_array_add (priv->names, (gpointer) last);
+    } while (tagsNext (tag_file, NULL) == TagSuccess);
+  
+  if (!sorted)
+    {
+      guint i;
+      guint length = 0;
+      g_ptr_array_sort (priv->names, compare_names);
+      for (i = 0; i < priv->names->len; i++)
+        {
+          name = g_ptr_array_index (priv->names, i);
+          if (length == 0 || strcmp (g_ptr_array_index (priv->names, length - 1), name) != 0)
+            priv->names->pdata[length++] = (gpointer) name;
+        }
+      g_ptr_array_set_size (priv->names, length);
+    }
+}
+
+static gint
+compare_names (gconstpointer a, 
+               gconstpointer b)
+{
+  return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+guint
+ctags_name_index_get_length (CtagsNameIndex *index)
+{
+  return CTAGS_NAME_INDEX_GET_PRIVATE (index)->names->len;
+}
+
+const gchar*
+ctags_name_index_get_name (CtagsNameIndex *index,
+                           guint           id)
+{
+  return g_ptr_array_index (CTAGS_NAME_INDEX_GET_PRIVATE (index)->names, id);
+}
+
+/*
+ * Appends to names the first max names, in name order, which start with 
+ * prefix and returns how many names start with it in all. The names are 
+ * owned by the index.
+ */
+guint
+ctags_name_index_lookup (CtagsNameIndex *index,
+                         const gchar    *prefix,
+                         guint           max,
+                         GPtrArray      *names)
+{
+  CtagsNameIndexPrivate *priv;
+  gsize length;
+  guint low = 0;
+  guint high;
+  guint first;
+  guint i;
+  
+  priv = CTAGS_NAME_INDEX_GET_PRIVATE (index);
+  length = strlen (prefix);
+  
+  high = priv->names->len;
+  while (low < high)
+    {
+      guint middle = low + (high - low) / 2;
+      if (strcmp (g_ptr_array_index (priv->names, middle), prefix) < 0)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+  first = low;
+  
+  high = priv->names->len;
+  while (low < high)
+    {
+      guint middle = low + (high - low) / 2;
+      if (strncmp (g_ptr_array_index (priv->names, middle), prefix, length) <= 0)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+  
+  for (i = first; i < low && i - first < max; i++)
+    g_ptr_array_add (names, g_ptr_array_index (priv->names, i));
+
+  return low - first;
+}
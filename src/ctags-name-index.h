@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __CTAGS_NAME_INDEX_H__
+#define	__CTAGS_NAME_INDEX_H__
+
+#include <gtk/gtk.h>
+#include "readtags.h"
+
+G_BEGIN_DECLS
+
+#define CTAGS_NAME_INDEX_TYPE            (ctags_name_index_get_type ())
+#define CTAGS_NAME_INDEX(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), CTAGS_NAME_INDEX_TYPE, CtagsNameIndex))
+#define CTAGS_NAME_INDEX_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), CTAGS_NAME_INDEX_TYPE, CtagsNameIndexClass))
+#define IS_CTAGS_NAME_INDEX(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), CTAGS_NAME_INDEX_TYPE))
+#define IS_CTAGS_NAME_INDEX_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), CTAGS_NAME_INDEX_TYPE))
+
+typedef struct _CtagsNameIndex CtagsNameIndex;
+typedef struct _CtagsNameIndexClass CtagsNameIndexClass;
+
+struct _CtagsNameIndex
+{
+  GObject parent_instance;
+};
+
+struct _CtagsNameIndexClass
+{
+  GObjectClass parent_class;
+};
+
+GType ctags_name_index_get_type (void) G_GNUC_CONST;
+
+CtagsNameIndex*  ctags_name_index_new         (tagFile        *tag_file);
+
+guint            ctags_name_index_get_length  (CtagsNameIndex *index);
+const gchar*     ctags_name_index_get_name    (CtagsNameIndex *index,
+                                               guint           id);
+guint            ctags_name_index_lookup      (CtagsNameIndex *index,
+                                               const gchar    *prefix,
+                                               guint           max,
+                                               GPtrArray      *names);
+
+G_END_DECLS
+
+#endif /* __CTAGS_NAME_INDEX_H__ */
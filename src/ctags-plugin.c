@@ -20,6 +20,7 @@
 #include "ctags-menu.h"
 #include "ctags-project-properties.h"
 #include "ctags-engine.h"
+#include "ctags-trace.h"
 #include <gtk/gtk.h>
 #include <glib.h>
 #include <gmodule.h>
@@ -35,6 +36,21 @@ G_MODULE_EXPORT
 void activate (CodeSlayer *codeslayer)
 {
   GtkAccelGroup *accel_group;
+  const gchar *trace_path;
+  
+  ctags_trace_init ();
+  
+  trace_path = g_getenv (CTAGS_TRACE_VARIABLE);
+  if (trace_path != NULL && *trace_path != '\0')
+    {
+      GError *error = NULL;
+      if (!ctags_trace_start (trace_path, &error))
+        {
+          g_warning ("Could not start tracing: %s", error->message);
+          g_error_free (error);
+        }
+    }
+
   accel_group = codeslayer_get_menu_bar_accel_group (codeslayer);
   menu = ctags_menu_new (accel_group);
 
@@ -43,6 +59,8 @@ void activate (CodeSlayer *codeslayer)
 
   codeslayer_add_to_menu_bar (codeslayer, GTK_MENU_ITEM (menu));
   codeslayer_add_to_project_properties (codeslayer, project_properties, _("Ctags"));
+  
+  ctags_engine_warm_up (engine);
 }
 
 G_MODULE_EXPORT
@@ -51,4 +69,5 @@ void deactivate (CodeSlayer *codeslayer)
   codeslayer_remove_from_menu_bar (codeslayer, GTK_MENU_ITEM (menu));
   codeslayer_remove_from_project_properties (codeslayer, project_properties);
   g_object_unref (engine);
+  ctags_trace_stop ();
 }
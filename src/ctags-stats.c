@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "ctags-stats.h"
+
+/*
+ * Counts what the engine does and how long it takes. Each histogram keeps 
+ * its values in buckets the way an HDR histogram does: every value below 
+ * SUB_BUCKETS has a bucket of its own, and each power of two above is 
+ * split into SUB_BUCKETS buckets of equal width, so any value is known to 
+ * within about six percent from a microsecond up to hours, in a fixed 
+ * amount of memory and with a constant cost per value.
+ */
+
+#define SUB_BUCKET_BITS 4
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+#define BUCKETS ((64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS)
+
+typedef struct
+{
+  guint64 count;
+  guint64 sum;
+  guint64 min;
+  guint64 max;
+  guint64 buckets[BUCKETS];
+} Histogram;
+
+static void ctags_stats_class_init  (CtagsStatsClass     *klass);
+static void ctags_stats_init        (CtagsStats          *stats);
+static void ctags_stats_finalize    (CtagsStats          *stats);
+
+static guint get_bucket             (guint64              value);
+static guint64 get_bucket_value     (guint                bucket);
+static guint64 get_percentile       (Histogram           *histogram,
+                                     gdouble              fraction);
+static void append_summary          (GString             *string,
+                                     CtagsStats          *stats);
+static void append_buckets          (GString             *string,
+                                     CtagsStats          *stats);
+
+#define CTAGS_STATS_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), CTAGS_STATS_TYPE, CtagsStatsPrivate))
+
+typedef struct _CtagsStatsPrivate CtagsStatsPrivate;
+
+struct _CtagsStatsPrivate
+{
+  gint64     started_time;
+  guint64    counters[CTAGS_STATS_COUNTERS];
+  Histogram *histograms;
+};
+
+static const gchar *counter_names[CTAGS_STATS_COUNTERS] = {
+  "rebuilds",
+  "updates",
+  "failed runs",
+  "lookups",
+  "lookups not found"
+};
+
+static const struct
+{
+  const gchar *name;
+  const gchar *unit;
+} histogram_names[CTAGS_STATS_HISTOGRAMS] = {
+  { "generation time", "us" },
+  { "files tagged", "files" },
+  { "tags file size", "bytes" },
+  { "lookup open", "us" },
+  { "lookup search", "us" },
+  { "lookup rank", "us" },
+  { "lookup navigate", "us" },
+  { "lookup total", "us" },
+  { "matches", "tags" }
+};
+
+G_DEFINE_TYPE (CtagsStats, ctags_stats, G_TYPE_OBJECT)
+
+static void 
+ctags_stats_class_init (CtagsStatsClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) ctags_stats_finalize;
+  g_type_class_add_private (klass, sizeof (CtagsStatsPrivate));
+}
+
+static void
+ctags_stats_init (CtagsStats *stats)
+{
+  CtagsStatsPrivate *priv;
+  priv = CTAGS_STATS_GET_PRIVATE (stats);
+  priv->histograms = g_new (Histogram, CTAGS_STATS_HISTOGRAMS);
+  ctags_stats_reset (stats);
+}
+
+static void
+ctags_stats_finalize (CtagsStats *stats)
+{
+  CtagsStatsPrivate *priv;
+  priv = CTAGS_STATS_GET_PRIVATE (stats);
+  g_free (priv->histograms);
+  G_OBJECT_CLASS (ctags_stats_parent_class)->finalize (G_OBJECT (stats));
+}
+
+CtagsStats*
+ctags_stats_new (void)
+{
+  return CTAGS_STATS (g_object_new (ctags_stats_get_type (), NULL));
+}
+
+void
+ctags_stats_increment (CtagsStats        *stats,
+                       CtagsStatsCounter  counter)
+{
+  CTAGS_STATS_GET_PRIVATE (stats)->counters[counter]++;
+}
+
+/*
+ * Negative values, which a clock stepping back could give, count as zero.
+ */
+void
+ctags_stats_record (CtagsStats          *stats,
+                    CtagsStatsHistogram  histogram,
+                    gint64               value)
+{
+  Histogram *h;
+  guint64 v;
+  
+  h = &CTAGS_STATS_GET_PRIVATE (stats)->histograms[histogram];
+  v = value > 0 ? (guint64) value : 0;
+  
+  if (h->count == 0 || v < h->min)
+    h->min = v;
+  if (h->count == 0 || v > h->max)
+    h->max = v;
+  
+  h->count++;
+  h->sum += v;
+  h->buckets[get_bucket (v)]++;
+}
+
+guint64
+ctags_stats_get_count (CtagsStats        *stats,
+                       CtagsStatsCounter  counter)
+{
+  return CTAGS_STATS_GET_PRIVATE (stats)->counters[counter];
+}
+
+/*
+ * Returns the value below which the fraction of the recorded values lie, 
+ * or -1 if none was recorded.
+ */
+gint64
+ctags_stats_percentile (CtagsStats          *stats,
+                        CtagsStatsHistogram  histogram,
+                        gdouble              fraction)
+{
+  Histogram *h;
+  h = &CTAGS_STATS_GET_PRIVATE (stats)->histograms[histogram];
+  if (h->count == 0)
+    return -1;
+  return get_percentile (h, fraction);
+}
+
+/*
+ * Returns the counters and a summary of each histogram as a table, to be 
+ * freed with g_free().
+ */
+gchar*
+ctags_stats_to_string (CtagsStats *stats)
+{
+  GString *string;
+  string = g_string_new (NULL);
+  append_summary (string, stats);
+  return g_string_free (string, FALSE);
+}
+
+/*
+ * Writes the summary followed by the counts of every bucket in use, which 
+ * are enough to merge the histograms of several sessions or to plot them.
+ */
+gboolean
+ctags_stats_save (CtagsStats   *stats,
+                  const gchar  *file_path,
+                  GError      **error)
+{
+  GString *string;
+  gboolean result;
+  
+  string = g_string_new (NULL);
+  append_summary (string, stats);
+  append_buckets (string, stats);
+  
+  result = g_file_set_contents (file_path, string->str, string->len, error);
+  
+  g_string_free (string, TRUE);
+  
+  return result;
+}
+
+void
+ctags_stats_reset (CtagsStats *stats)
+{
+  CtagsStatsPrivate *priv;
+  priv = CTAGS_STATS_GET_PRIVATE (stats);
+  priv->started_time = g_get_real_time ();
+  memset (priv->counters, 0, sizeof (priv->counters));
+  memset (priv->histograms, 0, CTAGS_STATS_HISTOGRAMS * sizeof (Histogram));
+}
+
+static guint
+get_bucket (guint64 value)
+{
+  guint exponent;
+  
+  if (value < SUB_BUCKETS)
+    return value;
+  
+  exponent = g_bit_storage (value) - 1;
+  return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + 
+         ((value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+}
+
+/*
+ * The highest value the bucket holds.
+ */
+static guint64
+get_bucket_value (guint bucket)
+{
+  guint shift;
+  guint64 lowest;
+  
+  if (bucket < SUB_BUCKETS)
+    return bucket;
+  
+  shift = bucket / SUB_BUCKETS - 1;
+  lowest = (guint64) (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+  return lowest + (((guint64) 1 << shift) - 1);
+}
+
+static guint64
+get_percentile (Histogram *histogram,
+                gdouble    fraction)
+{
+  guint64 rank;
+  guint64 seen = 0;
+  guint i;
+  
+  rank = (guint64) (fraction * histogram->count + 0.5);
+  rank = CLAMP (rank, 1, histogram->count);
+  
+  for (i = 0; i < BUCKETS; i++)
+    {
+      seen += histogram->buckets[i];
+      if (seen >= rank)
+        return MIN (get_bucket_value (i), histogram->max);
+    }
+  
+  return histogram->max;
+}
+
+static void
+append_summary (GString    *string,
+                CtagsStats *stats)
+{
+  CtagsStatsPrivate *priv;
+  GDateTime *date_time;
+  gchar *started;
+  guint i;
+  
+  priv = CTAGS_STATS_GET_PRIVATE (stats);
+  
+  date_time = g_date_time_new_from_unix_local (priv->started_time / G_USEC_PER_SEC);
+  started = g_date_time_format (date_time, "%Y-%m-%d %H:%M:%S");
+  g_string_append_printf (string, "since %s\n\n", started);
+  g_free (started);
+  g_date_time_unref (date_time);
+  
+  for (i = 0; i < CTAGS_STATS_COUNTERS; i++)
+    g_string_append_printf (string, "%-18s %" G_GUINT64_FORMAT "\n", 
+                            counter_names[i], priv->counters[i]);
+  
+  g_string_append_printf (string, "\n%-18s %-6s %8s %10s %10s %10s %10s %10s %10s %10s\n", 
+                          "", "unit", "count", "min", "mean", "p50", "p90", 
+                          "p99", "p99.9", "max");
+  
+  for (i = 0; i < CTAGS_STATS_HISTOGRAMS; i++)
+    {
+      Histogram *h = &priv->histograms[i];
+      
+      g_string_append_printf (string, "%-18s %-6s %8" G_GUINT64_FORMAT, 
+                              histogram_names[i].name, histogram_names[i].unit, 
+                              h->count);
+      
+      if (h->count > 0)
+        g_string_append_printf (string, 
+                                " %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT 
+                                " %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT 
+                                " %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT 
+                                " %10" G_GUINT64_FORMAT,
+                                h->min, h->sum / h->count, 
+                                get_percentile (h, 0.5), get_percentile (h, 0.9), 
+                                get_percentile (h, 0.99), get_percentile (h, 0.999), 
+                                h->max);
+      
+      g_string_append_c (string, '\n');
+    }
+}
+
+static void
+append_buckets (GString    *string,
+                CtagsStats *stats)
+{
+  CtagsStatsPrivate *priv;
+  guint i;
+  guint j;
+  
+  priv = CTAGS_STATS_GET_PRIVATE (stats);
+  
+  for (i = 0; i < CTAGS_STATS_HISTOGRAMS; i++)
+    {
+      Histogram *h = &priv->histograms[i];
+      
+      g_string_append_printf (string, "\n[%s]\n", histogram_names[i].name);
+      g_string_append_printf (string, "%-20s %s\n", histogram_names[i].unit, "count");
+      
+      for (j = 0; j < BUCKETS; j++)
+        if (h->buckets[j] > 0)
+          g_string_append_printf (string, "%-20" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT "\n", 
+                                  get_bucket_value (j), h->buckets[j]);
+    }
+}
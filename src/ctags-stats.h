@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __CTAGS_STATS_H__
+#define	__CTAGS_STATS_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define CTAGS_STATS_TYPE            (ctags_stats_get_type ())
+#define CTAGS_STATS(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), CTAGS_STATS_TYPE, CtagsStats))
+#define CTAGS_STATS_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), CTAGS_STATS_TYPE, CtagsStatsClass))
+#define IS_CTAGS_STATS(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), CTAGS_STATS_TYPE))
+#define IS_CTAGS_STATS_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), CTAGS_STATS_TYPE))
+
+typedef struct _CtagsStats CtagsStats;
+typedef struct _CtagsStatsClass CtagsStatsClass;
+
+struct _CtagsStats
+{
+  GObject parent_instance;
+};
+
+struct _CtagsStatsClass
+{
+  GObjectClass parent_class;
+};
+
+typedef enum
+{
+  CTAGS_STATS_REBUILDS,
+  CTAGS_STATS_UPDATES,
+  CTAGS_STATS_FAILED_RUNS,
+  CTAGS_STATS_LOOKUPS,
+  CTAGS_STATS_MISSED_LOOKUPS,
+  CTAGS_STATS_COUNTERS
+} CtagsStatsCounter;
+
+/* times are in microseconds and sizes in bytes */
+typedef enum
+{
+  CTAGS_STATS_GENERATION_TIME,
+  CTAGS_STATS_FILES_TAGGED,
+  CTAGS_STATS_TAGS_FILE_SIZE,
+  CTAGS_STATS_LOOKUP_OPEN,
+  CTAGS_STATS_LOOKUP_SEARCH,
+  CTAGS_STATS_LOOKUP_RANK,
+  CTAGS_STATS_LOOKUP_NAVIGATE,
+  CTAGS_STATS_LOOKUP_TOTAL,
+  CTAGS_STATS_MATCHES,
+  CTAGS_STATS_HISTOGRAMS
+} CtagsStatsHistogram;
+
+GType ctags_stats_get_type (void) G_GNUC_CONST;
+
+CtagsStats*  ctags_stats_new         (void);
+
+void         ctags_stats_increment   (CtagsStats          *stats,
+                                      CtagsStatsCounter    counter);
+void         ctags_stats_record      (CtagsStats          *stats,
+                                      CtagsStatsHistogram  histogram,
+                                      gint64               value);
+guint64      ctags_stats_get_count   (CtagsStats          *stats,
+                                      CtagsStatsCounter    counter);
+gint64       ctags_stats_percentile  (CtagsStats          *stats,
+                                      CtagsStatsHistogram  histogram,
+                                      gdouble              fraction);
+gchar*       ctags_stats_to_string   (CtagsStats          *stats);
+gboolean     ctags_stats_save        (CtagsStats          *stats,
+                                      const gchar         *file_path,
+                                      GError             **error);
+void         ctags_stats_reset       (CtagsStats          *stats);
+
+G_END_DECLS
+
+#endif /* __CTAGS_STATS_H__ */
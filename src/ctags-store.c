@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <glib/gstdio.h>
+#include "ctags-store.h"
+
+/*
+ * The store keeps the tag file open between lookups so that the
+ * pseudo-tags are only parsed, and the file only mapped, once per
+ * generation of the file. The handle is reopened whenever the device,
+ * inode, size or modification time of the file changes. Indexes derived 
+ * from the file are built on first use and dropped along with the handle.
+ */
+
+static void ctags_store_class_init  (CtagsStoreClass *klass);
+static void ctags_store_init        (CtagsStore      *store);
+static void ctags_store_finalize    (CtagsStore      *store);
+
+static gboolean is_current          (CtagsStore      *store, 
+                                     GStatBuf        *stat_buf);
+
+#define CTAGS_STORE_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), CTAGS_STORE_TYPE, CtagsStorePrivate))
+
+typedef struct _CtagsStorePrivate CtagsStorePrivate;
+
+struct _CtagsStorePrivate
+{
+  gchar            *file_path;
+  tagFile          *tag_file;
+  CtagsNameIndex   *name_index;
+  CtagsSymbolIndex *symbol_index;
+  dev_t             device;
+  ino_t             inode;
+  goffset           size;
+  time_t            modified;
+  guint             generation;
+};
+
+G_DEFINE_TYPE (CtagsStore, ctags_store, G_TYPE_OBJECT)
+
+static void 
+ctags_store_class_init (CtagsStoreClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) ctags_store_finalize;
+  g_type_class_add_private (klass, sizeof (CtagsStorePrivate));
+}
+
+static void
+ctags_store_init (CtagsStore *store)
+{
+  CtagsStorePrivate *priv;
+  priv = CTAGS_STORE_GET_PRIVATE (store);
+  priv->file_path = NULL;
+  priv->tag_file = NULL;
+  priv->name_index = NULL;
+  priv->symbol_index = NULL;
+  priv->generation = 0;
+}
+
+static void
+ctags_store_finalize (CtagsStore *store)
+{
+  CtagsStorePrivate *priv;
+  priv = CTAGS_STORE_GET_PRIVATE (store);
+
+  ctags_store_invalidate (store);
+
+  if (priv->file_path != NULL)
+    g_free (priv->file_path);
+      
+  G_OBJECT_CLASS (ctags_store_parent_class)->finalize (G_OBJECT (store));
+}
+
+CtagsStore*
+ctags_store_new (const gchar *file_path)
+{
+  CtagsStore *store;
+  store = CTAGS_STORE (g_object_new (ctags_store_get_type (), NULL));
+  CTAGS_STORE_GET_PRIVATE (store)->file_path = g_strdup (file_path);
+  return store;
+}
+
+const gchar*
+ctags_store_get_file_path (CtagsStore *store)
+{
+  return CTAGS_STORE_GET_PRIVATE (store)->file_path;
+}
+
+/*
+ * Returns the open tag file, reopened if the file changed. The store owns it.
+ */
+tagFile*
+ctags_store_get_tag_file (CtagsStore *store)
+{
+  CtagsStorePrivate *priv;
+  GStatBuf stat_buf;
+  tagFileInfo info;
+  
+  priv = CTAGS_STORE_GET_PRIVATE (store);
+  
+  if (g_stat (priv->file_path, &stat_buf) != 0)
+    {
+      ctags_store_invalidate (store);
+      return NULL;
+    }
+  
+  if (priv->tag_file != NULL && is_current (store, &stat_buf))
+    return priv->tag_file;
+
+  ctags_store_invalidate (store);
+  
+  priv->tag_file = tagsOpen (priv->file_path, &info);
+  if (priv->tag_file == NULL)
+    return NULL;
+  
+  /* lookups mostly need just the file and line of each match */
+  tagsSetLazyFields (priv->tag_file, TRUE);
+
+  priv->device = stat_buf.st_dev;
+  priv->inode = stat_buf.st_ino;
+  priv->size = stat_buf.st_size;
+  priv->modified = stat_buf.st_mtime;
+  priv->generation++;
+  
+  return priv->tag_file;
+}
+
+/*
+ * Returns a number which changes whenever the tag file is opened again.
+ */
+guint
+ctags_store_get_generation (CtagsStore *store)
+{
+  return CTAGS_STORE_GET_PRIVATE (store)->generation;
+}
+
+/*
+ * Closes the tag file, which is needed before rewriting it in place.
+ */
+void
+ctags_store_invalidate (CtagsStore *store)
+{
+  CtagsStorePrivate *priv;
+  priv = CTAGS_STORE_GET_PRIVATE (store);
+  
+  if (priv->symbol_index != NULL)
+    {
+      g_object_unref (priv->symbol_index);
+      priv->symbol_index = NULL;
+    }
+  
+  if (priv->name_index != NULL)
+    {
+      g_object_unref (priv->name_index);
+      priv->name_index = NULL;
+    }
+  
+  if (priv->tag_file != NULL)
+    {
+      tagsClose (priv->tag_file);
+      priv->tag_file = NULL;
+    }
+}
+
+/*
+ * Returns the index of the tag names, valid until the tag file changes.
+ */
+CtagsNameIndex*
+ctags_store_get_name_index (CtagsStore *store)
+{
+  CtagsStorePrivate *priv;
+  tagFile *tag_file;
+  
+  priv = CTAGS_STORE_GET_PRIVATE (store);
+  
+  tag_file = ctags_store_get_tag_file (store);
+  if (tag_file == NULL)
+    return NULL;
+  
+  if (priv->name_index == NULL)
+    priv->name_index = ctags_name_index_new (tag_file);
+  
+  return priv->name_index;
+}
+
+/*
+ * Returns the trigram index of the tag names, valid until the tag file changes.
+ */
+CtagsSymbolIndex*
+ctags_store_get_symbol_index (CtagsStore *store)
+{
+  CtagsStorePrivate *priv;
+  CtagsNameIndex *name_index;
+  
+  priv = CTAGS_STORE_GET_PRIVATE (store);
+  
+  name_index = ctags_store_get_name_index (store);
+  if (name_index == NULL)
+    return NULL;
+  
+  if (priv->symbol_index == NULL)
+    priv->symbol_index = ctags_symbol_index_new (name_index);
+  
+  return priv->symbol_index;
+}
+
+static gboolean
+is_current (CtagsStore *store, 
+            GStatBuf   *stat_buf)
+{
+  CtagsStorePrivate *priv;
+  priv = CTAGS_STORE_GET_PRIVATE (store);
+  return priv->device == stat_buf->st_dev &&
+         priv->inode == stat_buf->st_ino &&
+         priv->size == stat_buf->st_size &&
+         priv->modified == stat_buf->st_mtime;
+}
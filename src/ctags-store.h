@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __CTAGS_STORE_H__
+#define	__CTAGS_STORE_H__
+
+#include <gtk/gtk.h>
+#include "ctags-name-index.h"
+#include "ctags-symbol-index.h"
+#include "readtags.h"
+
+G_BEGIN_DECLS
+
+#define CTAGS_STORE_TYPE            (ctags_store_get_type ())
+#define CTAGS_STORE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), CTAGS_STORE_TYPE, CtagsStore))
+#define CTAGS_STORE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), CTAGS_STORE_TYPE, CtagsStoreClass))
+#define IS_CTAGS_STORE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), CTAGS_STORE_TYPE))
+#define IS_CTAGS_STORE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), CTAGS_STORE_TYPE))
+
+typedef struct _CtagsStore CtagsStore;
+typedef struct _CtagsStoreClass CtagsStoreClass;
+
+struct _CtagsStore
+{
+  GObject parent_instance;
+};
+
+struct _CtagsStoreClass
+{
+  GObjectClass parent_class;
+};
+
+GType ctags_store_get_type (void) G_GNUC_CONST;
+
+CtagsStore*        ctags_store_new               (const gchar *file_path);
+
+const gchar*       ctags_store_get_file_path     (CtagsStore  *store);
+tagFile*           ctags_store_get_tag_file      (CtagsStore  *store);
+CtagsNameIndex*    ctags_store_get_name_index    (CtagsStore  *store);
+CtagsSymbolIndex*  ctags_store_get_symbol_index  (CtagsStore  *store);
+guint              ctags_store_get_generation    (CtagsStore  *store);
+void               ctags_store_invalidate        (CtagsStore  *store);
+
+G_END_DECLS
+
+#endif /* __CTAGS_STORE_H__ */
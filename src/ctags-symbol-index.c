@@ -0,0 +1,481 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "ctags-symbol-index.h"
+
+/*
+ * Substring and fuzzy ("cfgsrcfold" for "ctags_config_get_source_folder")
+ * search over the distinct tag names. Every name is broken into case 
+ * folded trigrams and a posting list of name ids is kept per trigram, so 
+ * names containing the query are found from the shortest posting list of 
+ * its trigrams. Fuzzy matches, where the query only has to be a 
+ * subsequence of the name, cannot be found through trigrams; those are 
+ * found by scanning a bit mask of the characters in each name, which 
+ * discards almost every name with a single comparison. Only the best 
+ * matches are kept, in a bounded heap.
+ */
+
+#define TRIGRAMS (1 << 18)
+#define SUBSTRING_SCORE 1000
+#define MAX_FUZZY_SCORE (SUBSTRING_SCORE - 201)
+
+typedef struct
+{
+  guint id;
+  gint  score;
+} Match;
+
+static void ctags_symbol_index_class_init  (CtagsSymbolIndexClass *klass);
+static void ctags_symbol_index_init        (CtagsSymbolIndex      *index);
+static void ctags_symbol_index_finalize    (CtagsSymbolIndex      *index);
+
+static void build_postings                 (CtagsSymbolIndex      *index);
+static guint symbol_code                   (guchar                 c);
+static guint trigram                       (const gchar           *text);
+static gboolean is_boundary                (const gchar           *name, 
+                                            gsize                  i);
+static gint find_folded                    (const gchar           *name, 
+                                            const gchar           *query);
+static gint substring_score                (const gchar           *name, 
+                                            gint                   position, 
+                                            gsize                  query_length);
+static gint fuzzy_score                    (const gchar           *name, 
+                                            const gchar           *query);
+static void add_match                      (GArray                *heap, 
+                                            guint                  max, 
+                                            guint                  id, 
+                                            gint                   score);
+static gint compare_matches                (gconstpointer          a, 
+                                            gconstpointer          b);
+
+#define CTAGS_SYMBOL_INDEX_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), CTAGS_SYMBOL_INDEX_TYPE, CtagsSymbolIndexPrivate))
+
+typedef struct _CtagsSymbolIndexPrivate CtagsSymbolIndexPrivate;
+
+struct _CtagsSymbolIndexPrivate
+{
+  CtagsNameIndex *name_index;
+  guint           length;
+  guint64        *masks;
+  guint32        *offsets;
+  guint32        *postings;
+};
+
+G_DEFINE_TYPE (CtagsSymbolIndex, ctags_symbol_index, G_TYPE_OBJECT)
+
+static void 
+ctags_symbol_index_class_init (CtagsSymbolIndexClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) ctags_symbol_index_finalize;
+  g_type_class_add_private (klass, sizeof (CtagsSymbolIndexPrivate));
+}
+
+static void
+ctags_symbol_index_init (CtagsSymbolIndex *index)
+{
+  CtagsSymbolIndexPrivate *priv;
+  priv = CTAGS_SYMBOL_INDEX_GET_PRIVATE (index);
+  priv->name_index = NULL;
+  priv->masks = NULL;
+  priv->offsets = NULL;
+  priv->postings = NULL;
+}
+
+static void
+ctags_symbol_index_finalize (CtagsSymbolIndex *index)
+{
+  CtagsSymbolIndexPrivate *priv;
+  priv = CTAGS_SYMBOL_INDEX_GET_PRIVATE (index);
+  g_free (priv->masks);
+  g_free (priv->offsets);
+  g_free (priv->postings);
+  if (priv->name_index != NULL)
+    g_object_unref (priv->name_index);
+  G_OBJECT_CLASS (ctags_symbol_index_parent_class)->finalize (G_OBJECT (index));
+}
+
+CtagsSymbolIndex*
+ctags_symbol_index_new (CtagsNameIndex *name_index)
+{
+  CtagsSymbolIndexPrivate *priv;
+  CtagsSymbolIndex *index;
+  
+  index = CTAGS_SYMBOL_INDEX (g_object_new (ctags_symbol_index_get_type (), NULL));
+  priv = CTAGS_SYMBOL_INDEX_GET_PRIVATE (index);
+  
+  priv->name_index = g_object_ref (name_index);
+  priv->length = ctags_name_index_get_length (name_index);
+  build_postings (index);
+  
+  return index;
+}
+
+/*
+ * Two passes over the names: the first counts the names per trigram and 
+ * the second fills in the posting lists, laid out one after the other. A 
+ * trigram occurring more than once in a name is only posted once.
+ */
+static void
+build_postings (CtagsSymbolIndex *index)
+{
+  CtagsSymbolIndexPrivate *priv;
+  guint32 *last;
+  guint32 *cursor;
+  guint32 total = 0;
+  guint pass;
+  guint id;
+  guint t;
+  
+  priv = CTAGS_SYMBOL_INDEX_GET_PRIVATE (index);
+  
+  priv->masks = g_new (guint64, MAX (priv->length, 1));
+  priv->offsets = g_new0 (guint32, TRIGRAMS + 1);
+  cursor = g_new0 (guint32, TRIGRAMS);
+  last = g_new (guint32, TRIGRAMS);
+  
+  for (pass = 0; pass < 2; pass++)
+    {
+      memset (last, 0xff, TRIGRAMS * sizeof (guint32));
+      
+      for (id = 0; id < priv->length; id++)
+        {
+          const gchar *name = ctags_name_index_get_name (priv->name_index, id);
+          guint64 mask = 0;
+          gsize i;
+          
+          for (i = 0; name[i] != '\0'; i++)
+            {
+              mask |= G_GUINT64_CONSTANT (1) << symbol_code (name[i]);
+              if (name[i + 1] != '\0' && name[i + 2] != '\0')
+                {
+                  t = trigram (name + i);
+                  if (last[t] == id)
+                    continue;
+                  last[t] = id;
+                  if (pass == 0)
+                    priv->offsets[t + 1]++;
+                  else
+                    priv->postings[cursor[t]++] = id;
+                }
+            }
+          priv->masks[id] = mask;
+        }
+      
+      if (pass == 0)
+        {
+          for (t = 0; t < TRIGRAMS; t++)
+            {
+              total += priv->offsets[t + 1];
+              priv->offsets[t + 1] = total;
+              cursor[t] = priv->offsets[t];
+            }
+          priv->postings = g_new (guint32, MAX (total, 1));
+        }
+    }
+  
+  g_free (cursor);
+  g_free (last);
+}
+
+/*
+ * Case folded six bit code of a character. Characters other than letters, 
+ * digits and underscores share codes, which only costs extra candidates 
+ * since every candidate is verified against the name.
+ */
+static guint
+symbol_code (guchar c)
+{
+  c = g_ascii_tolower (c);
+  if (c >= 'a' && c <= 'z')
+    return 1 + c - 'a';
+  if (c >= '0' && c <= '9')
+    return 27 + c - '0';
+  if (c == '_')
+    return 37;
+  return 38 + c % 26;
+}
+
+static guint
+trigram (const gchar *text)
+{
+  return symbol_code (text[0]) << 12 | symbol_code (text[1]) << 6 | symbol_code (text[2]);
+}
+
+/*
+ * Calls func with up to max names matching query, best match first. Names 
+ * containing the query rank above names which only contain its characters
+ * in order; within each group, matches at the start of the name or of a 
+ * word within it, exact matches and shorter names rank higher.
+ */
+void
+ctags_symbol_index_search (CtagsSymbolIndex *index,
+                           const gchar      *query,
+                           guint             max,
+                           CtagsSymbolFunc   func,
+                           gpointer          user_data)
+{
+  CtagsSymbolIndexPrivate *priv;
+  GArray *heap;
+  guint8 *substrings = NULL;
+  guint64 query_mask = 0;
+  gchar *folded;
+  gsize length;
+  guint id;
+  guint i;
+  
+  priv = CTAGS_SYMBOL_INDEX_GET_PRIVATE (index);
+  
+  folded = g_ascii_strdown (query, -1);
+  length = strlen (folded);
+  if (length == 0 || max == 0)
+    {
+      g_free (folded);
+      return;
+    }
+  
+  heap = g_array_sized_new (FALSE, FALSE, sizeof (Match), max);
+  
+  for (i = 0; i < length; i++)
+    query_mask |= G_GUINT64_CONSTANT (1) << symbol_code (folded[i]);
+  
+  if (length >= 3)
+    {
+      guint shortest = trigram (folded);
+      guint found = 0;
+      
+      for (i = 1; i + 2 < length; i++)
+        {
+          guint t = trigram (folded + i);
+          if (priv->offsets[t + 1] - priv->offsets[t] < 
+              priv->offsets[shortest + 1] - priv->offsets[shortest])
+            shortest = t;
+        }
+      
+      substrings = g_new0 (guint8, priv->length / 8 + 1);
+      
+      for (i = priv->offsets[shortest]; i < priv->offsets[shortest + 1]; i++)
+        {
+          const gchar *name;
+          gint position;
+          id = priv->postings[i];
+          name = ctags_name_index_get_name (priv->name_index, id);
+          position = find_folded (name, folded);
+          if (position >= 0)
+            {
+              substrings[id / 8] |= 1 << (id % 8);
+              add_match (heap, max, id, substring_score (name, position, length));
+              found++;
+            }
+        }
+      
+      /* every fuzzy match would rank below the substring matches */
+      if (found >= max)
+        length = 0;
+    }
+
+  for (id = 0; length > 0 && id < priv->length; id++)
+    {
+      const gchar *name;
+      gint score;
+      
+      if ((priv->masks[id] & query_mask) != query_mask)
+        continue;
+      if (substrings != NULL && (substrings[id / 8] & (1 << (id % 8))))
+        continue;
+      
+      name = ctags_name_index_get_name (priv->name_index, id);
+      
+      if (substrings == NULL)
+        {
+          gint position = find_folded (name, folded);
+          if (position >= 0)
+            {
+              add_match (heap, max, id, substring_score (name, position, length));
+              continue;
+            }
+        }
+      
+      score = fuzzy_score (name, folded);
+      if (score >= 0)
+        add_match (heap, max, id, score);
+    }
+  
+  g_array_sort (heap, compare_matches);
+  
+  for (i = 0; i < heap->len; i++)
+    {
+      Match *match = &g_array_index (heap, Match, i);
+      const gchar *name = ctags_name_index_get_name (priv->name_index, match->id);
+      if (!func (name, match->score, user_data))
+        break;
+    }
+  
+  g_array_free (heap, TRUE);
+  g_free (substrings);
+  g_free (folded);
+}
+
+static gboolean
+is_boundary (const gchar *name, 
+             gsize        i)
+{
+  return i == 0 || 
+         !g_ascii_isalnum (name[i - 1]) ||
+         (g_ascii_islower (name[i - 1]) && g_ascii_isupper (name[i]));
+}
+
+/*
+ * Position of the lower case query within name, ignoring case, or -1.
+ */
+static gint
+find_folded (const gchar *name, 
+             const gchar *query)
+{
+  gsize i;
+  for (i = 0; name[i] != '\0'; i++)
+    {
+      gsize j = 0;
+      while (query[j] != '\0' && g_ascii_tolower (name[i + j]) == query[j])
+        j++;
+      if (query[j] == '\0')
+        return (gint) i;
+    }
+  return -1;
+}
+
+static gint
+substring_score (const gchar *name, 
+                 gint         position, 
+                 gsize        query_length)
+{
+  gsize name_length = strlen (name);
+  gint score = SUBSTRING_SCORE;
+  
+  if (position == 0)
+    score += 500;
+  else if (is_boundary (name, position))
+    score += 100;
+  
+  if (name_length == query_length)
+    score += 200;
+  
+  return score - (gint) MIN (name_length, 200);
+}
+
+/*
+ * Scores name if the lower case query is a subsequence of it, ignoring 
+ * case, or returns -1. Characters matched at the start of a word, or 
+ * straight after the previous match, score extra.
+ */
+static gint
+fuzzy_score (const gchar *name, 
+             const gchar *query)
+{
+  const gchar *q = query;
+  gint previous = -2;
+  gint score = 0;
+  gsize i;
+  
+  for (i = 0; name[i] != '\0' && *q != '\0'; i++)
+    {
+      if (g_ascii_tolower (name[i]) != *q)
+        continue;
+      score += 10;
+      if (is_boundary (name, i))
+        score += 15;
+      if ((gint) i == previous + 1)
+        score += 8;
+      previous = (gint) i;
+      q++;
+    }
+  
+  if (*q != '\0')
+    return -1;
+  
+  while (name[i] != '\0')
+    i++;
+  
+  return CLAMP (score - (gint) (i / 4), 0, MAX_FUZZY_SCORE);
+}
+
+/*
+ * Keeps the max best matches in a min-heap on score.
+ */
+static void
+add_match (GArray *heap, 
+           guint   max, 
+           guint   id, 
+           gint    score)
+{
+  Match *matches;
+  guint i;
+  
+  if (heap->len < max)
+    {
+      Match match = { id, score };
+      g_array_append_val (heap, match);
+      matches = (Match *) heap->data;
+      i = heap->len - 1;
+      while (i > 0 && matches[(i - 1) / 2].score > matches[i].score)
+        {
+          Match swap = matches[i];
+          matches[i] = matches[(i - 1) / 2];
+          matches[(i - 1) / 2] = swap;
+          i = (i - 1) / 2;
+        }
+      return;
+    }
+  
+  matches = (Match *) heap->data;
+  if (score <= matches[0].score)
+    return;
+  
+  matches[0].id = id;
+  matches[0].score = score;
+  i = 0;
+  for (;;)
+    {
+      guint smallest = i;
+      guint left = 2 * i + 1;
+      guint right = left + 1;
+      Match swap;
+      if (left < heap->len && matches[left].score < matches[smallest].score)
+        smallest = left;
+      if (right < heap->len && matches[right].score < matches[smallest].score)
+        smallest = right;
+      if (smallest == i)
+        break;
+      swap = matches[i];
+      matches[i] = matches[smallest];
+      matches[smallest] = swap;
+      i = smallest;
+    }
+}
+
+static gint
+compare_matches (gconstpointer a, 
+                 gconstpointer b)
+{
+  const Match *x = a;
+  const Match *y = b;
+  if (x->score != y->score)
+    return y->score - x->score;
+  return (x->id > y->id) - (x->id < y->id);
+}
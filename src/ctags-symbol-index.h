@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __CTAGS_SYMBOL_INDEX_H__
+#define	__CTAGS_SYMBOL_INDEX_H__
+
+#include <gtk/gtk.h>
+#include "ctags-name-index.h"
+
+G_BEGIN_DECLS
+
+#define CTAGS_SYMBOL_INDEX_TYPE            (ctags_symbol_index_get_type ())
+#define CTAGS_SYMBOL_INDEX(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), CTAGS_SYMBOL_INDEX_TYPE, CtagsSymbolIndex))
+#define CTAGS_SYMBOL_INDEX_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), CTAGS_SYMBOL_INDEX_TYPE, CtagsSymbolIndexClass))
+#define IS_CTAGS_SYMBOL_INDEX(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), CTAGS_SYMBOL_INDEX_TYPE))
+#define IS_CTAGS_SYMBOL_INDEX_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), CTAGS_SYMBOL_INDEX_TYPE))
+
+typedef struct _CtagsSymbolIndex CtagsSymbolIndex;
+typedef struct _CtagsSymbolIndexClass CtagsSymbolIndexClass;
+
+struct _CtagsSymbolIndex
+{
+  GObject parent_instance;
+};
+
+struct _CtagsSymbolIndexClass
+{
+  GObjectClass parent_class;
+};
+
+/*
+ * Called for each result of a search, best match first. Returning FALSE 
+ * stops the search.
+ */
+typedef gboolean (*CtagsSymbolFunc) (const gchar *name,
+                                     gint         score,
+                                     gpointer     user_data);
+
+GType ctags_symbol_index_get_type (void) G_GNUC_CONST;
+
+CtagsSymbolIndex*  ctags_symbol_index_new     (CtagsNameIndex   *name_index);
+
+void               ctags_symbol_index_search  (CtagsSymbolIndex *index,
+                                               const gchar      *query,
+                                               guint             max,
+                                               CtagsSymbolFunc   func,
+                                               gpointer          user_data);
+
+G_END_DECLS
+
+#endif /* __CTAGS_SYMBOL_INDEX_H__ */
@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include "ctags-trace.h"
+#include "readtags.h"
+
+/*
+ * Writes what the engine does as trace events in the JSON format read by 
+ * chrome://tracing and Perfetto, for a timeline of a slow lookup or of a 
+ * freeze after a save. Spans are written as they end, from any thread, 
+ * and the lookups of readtags are traced through its hook.
+ *
+ * A span is taken by getting its start time from ctags_trace_now(), which 
+ * is 0 while no trace is running, and handing it to ctags_trace_span() 
+ * once done, which returns at once for a start time of 0. So with tracing 
+ * off a span costs two calls and a test, and so does an operation of 
+ * readtags, whose hook is installed once by ctags_trace_init().
+ */
+
+typedef struct
+{
+  gint     id;
+  gint     trace;
+  gboolean main;
+  gint64   hook_times[TAG_TRACE_PROBE + 1];
+} ThreadState;
+
+static ThreadState* get_thread_state  (void);
+static void write_event               (const gchar   *phase,
+                                       const gchar   *category,
+                                       const gchar   *name,
+                                       gint64         time,
+                                       gint64         duration,
+                                       gconstpointer  id,
+                                       const gchar   *detail);
+static void append_string             (GString       *string,
+                                       const gchar   *value);
+static void trace_hook                (const tagTraceEvent  event, 
+                                       const int            begin, 
+                                       const long           position, 
+                                       void *const          data);
+
+static GMutex mutex;
+static volatile gint running = 0;
+static gint thread_count = 0;
+static gint trace_count = 0;
+static GThread *main_thread = NULL;
+static FILE *trace_file = NULL;
+static gchar *trace_path = NULL;
+static gboolean first_event;
+static GString *buffer = NULL;
+static GPrivate thread_state = G_PRIVATE_INIT (g_free);
+
+static const gchar *hook_names[TAG_TRACE_PROBE + 1] = {
+  "tagsOpen",
+  "findBinary",
+  "probe"
+};
+
+/*
+ * Hooks the tracing into readtags, which reads the hook unlocked, so this 
+ * is called on the main thread before any other thread uses readtags.
+ */
+void
+ctags_trace_init (void)
+{
+  main_thread = g_thread_self ();
+  tagsSetTraceHook (trace_hook, NULL);
+}
+
+/*
+ * Starts writing the trace into the file, replacing it. Returns FALSE if 
+ * a trace is already running or the file could not be created.
+ */
+gboolean
+ctags_trace_start (const gchar  *file_path,
+                   GError      **error)
+{
+  FILE *stream;
+  
+  if (ctags_trace_is_running ())
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_EXIST,
+                   "A trace is already being written to %s", trace_path);
+      return FALSE;
+    }
+  
+  stream = fopen (file_path, "w");
+  if (stream == NULL)
+    {
+      gint saved_errno = errno;
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                   "Could not create %s: %s", file_path, g_strerror (saved_errno));
+      return FALSE;
+    }
+  
+  g_mutex_lock (&mutex);
+  trace_file = stream;
+  g_free (trace_path);
+  trace_path = g_strdup (file_path);
+  buffer = g_string_new (NULL);
+  first_event = TRUE;
+  trace_count++;
+  fputs ("[\n", trace_file);
+  g_mutex_unlock (&mutex);
+  
+  g_atomic_int_set (&running, 1);
+  
+  write_event ("M", NULL, "process_name", 0, -1, NULL, "codeslayer");
+  
+  return TRUE;
+}
+
+/*
+ * Closes the trace. Spans which have started but not ended are left out.
+ */
+void
+ctags_trace_stop (void)
+{
+  if (!ctags_trace_is_running ())
+    return;
+  
+  g_atomic_int_set (&running, 0);
+  
+  g_mutex_lock (&mutex);
+  fputs ("\n]\n", trace_file);
+  fclose (trace_file);
+  trace_file = NULL;
+  g_string_free (buffer, TRUE);
+  buffer = NULL;
+  g_mutex_unlock (&mutex);
+}
+
+gboolean
+ctags_trace_is_running (void)
+{
+  return g_atomic_int_get (&running) != 0;
+}
+
+/*
+ * The file of the running trace, or of the last one.
+ */
+const gchar*
+ctags_trace_get_file_path (void)
+{
+  return trace_path;
+}
+
+gint64
+ctags_trace_now (void)
+{
+  if (G_LIKELY (g_atomic_int_get (&running) == 0))
+    return 0;
+  return g_get_monotonic_time ();
+}
+
+/*
+ * Ends a span on the thread which started it. The detail, if any, is 
+ * shown with the span.
+ */
+void
+ctags_trace_span (const gchar *category,
+                  const gchar *name,
+                  gint64       start_time,
+                  const gchar *detail)
+{
+  if (G_LIKELY (start_time == 0))
+    return;
+  write_event ("X", category, name, start_time, 
+               g_get_monotonic_time () - start_time, NULL, detail);
+}
+
+/*
+ * Async spans may end on another thread or callback than they started 
+ * in. They are told apart by id, which is usually the object they are 
+ * about.
+ */
+void
+ctags_trace_async_begin (const gchar   *category,
+                         const gchar   *name,
+                         gconstpointer  id)
+{
+  if (G_LIKELY (g_atomic_int_get (&running) == 0))
+    return;
+  write_event ("b", category, name, g_get_monotonic_time (), -1, id, NULL);
+}
+
+void
+ctags_trace_async_end (const gchar   *category,
+                       const gchar   *name,
+                       gconstpointer  id)
+{
+  if (G_LIKELY (g_atomic_int_get (&running) == 0))
+    return;
+  write_event ("e", category, name, g_get_monotonic_time (), -1, id, NULL);
+}
+
+/*
+ * Threads are numbered in the order they first write to a trace, and each 
+ * is named in the trace as it does.
+ */
+static ThreadState*
+get_thread_state (void)
+{
+  ThreadState *state;
+  
+  state = g_private_get (&thread_state);
+  if (state == NULL)
+    {
+      state = g_new0 (ThreadState, 1);
+      state->id = g_atomic_int_add (&thread_count, 1) + 1;
+      state->main = g_thread_self () == main_thread;
+      g_private_set (&thread_state, state);
+    }
+  
+  return state;
+}
+
+static void
+write_event (const gchar   *phase,
+             const gchar   *category,
+             const gchar   *name,
+             gint64         time,
+             gint64         duration,
+             gconstpointer  id,
+             const gchar   *detail)
+{
+  ThreadState *state;
+  
+  state = get_thread_state ();
+  
+  g_mutex_lock (&mutex);
+  
+  if (trace_file == NULL)
+    {
+      g_mutex_unlock (&mutex);
+      return;
+    }
+  
+  g_string_truncate (buffer, 0);
+  
+  /* a thread is named the first time it writes to this trace */
+  if (state->trace != trace_count && *phase != 'M')
+    {
+      state->trace = trace_count;
+      g_string_append_printf (buffer, "%s{\"ph\":\"M\",\"name\":\"thread_name\","
+                              "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                              first_event ? "" : ",\n", (gint) getpid (), state->id);
+      append_string (buffer, state->main ? "main" : "worker");
+      g_string_append (buffer, "}}");
+      first_event = FALSE;
+    }
+  
+  g_string_append_printf (buffer, "%s{\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"name\":", 
+                          first_event ? "" : ",\n", phase, (gint) getpid (), state->id);
+  append_string (buffer, name);
+  
+  if (category != NULL)
+    {
+      g_string_append (buffer, ",\"cat\":");
+      append_string (buffer, category);
+    }
+  
+  if (*phase != 'M')
+    g_string_append_printf (buffer, ",\"ts\":%" G_GINT64_FORMAT, time);
+  
+  if (duration >= 0)
+    g_string_append_printf (buffer, ",\"dur\":%" G_GINT64_FORMAT, duration);
+  
+  if (id != NULL)
+    g_string_append_printf (buffer, ",\"id\":\"%p\"", id);
+  
+  if (detail != NULL)
+    {
+      g_string_append (buffer, *phase == 'M' ? ",\"args\":{\"name\":" : ",\"args\":{\"detail\":");
+      append_string (buffer, detail);
+      g_string_append_c (buffer, '}');
+    }
+  
+  g_string_append_c (buffer, '}');
+  first_event = FALSE;
+  
+  fwrite (buffer->str, 1, buffer->len, trace_file);
+  
+  g_mutex_unlock (&mutex);
+}
+
+static void
+append_string (GString     *string,
+               const gchar *value)
+{
+  const gchar *p;
+  
+  g_string_append_c (string, '"');
+  
+  for (p = value; *p != '\0'; p++)
+    {
+      guchar c = *p;
+      if (c == '"' || c == '\\')
+        {
+          g_string_append_c (string, '\\');
+          g_string_append_c (string, c);
+        }
+      else if (c < 0x20)
+        {
+          g_string_append_printf (string, "\\u%04x", c);
+        }
+      else
+        {
+          g_string_append_c (string, c);
+        }
+    }
+  
+  g_string_append_c (string, '"');
+}
+
+/*
+ * The operations of readtags do not nest within a kind, so the start of 
+ * each is kept per thread until it ends.
+ */
+static void
+trace_hook (const tagTraceEvent  event, 
+            const int            begin, 
+            const long           position, 
+            void *const          data)
+{
+  ThreadState *state;
+  gchar detail[32];
+  
+  if (G_LIKELY (g_atomic_int_get (&running) == 0))
+    return;
+  
+  state = get_thread_state ();
+  
+  if (begin)
+    {
+      state->hook_times[event] = ctags_trace_now ();
+      return;
+    }
+  
+  if (position >= 0)
+    {
+      g_snprintf (detail, sizeof (detail), "offset %ld", position);
+      ctags_trace_span ("readtags", hook_names[event], state->hook_times[event], detail);
+    }
+  else
+    {
+      ctags_trace_span ("readtags", hook_names[event], state->hook_times[event], NULL);
+    }
+  
+  /* an operation begun before the trace started has no start time */
+  state->hook_times[event] = 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __CTAGS_TRACE_H__
+#define	__CTAGS_TRACE_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define CTAGS_TRACE_VARIABLE "CTAGS_TRACE"
+
+void          ctags_trace_init           (void);
+gboolean      ctags_trace_start          (const gchar   *file_path,
+                                          GError       **error);
+void          ctags_trace_stop           (void);
+gboolean      ctags_trace_is_running     (void);
+const gchar*  ctags_trace_get_file_path  (void);
+
+gint64        ctags_trace_now            (void);
+void          ctags_trace_span           (const gchar   *category,
+                                          const gchar   *name,
+                                          gint64         start_time,
+                                          const gchar   *detail);
+void          ctags_trace_async_begin    (const gchar   *category,
+                                          const gchar   *name,
+                                          gconstpointer  id);
+void          ctags_trace_async_end      (const gchar   *category,
+                                          const gchar   *name,
+                                          gconstpointer  id);
+
+G_END_DECLS
+
+#endif /* __CTAGS_TRACE_H__ */
@@ -0,0 +1,673 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include "ctags-watcher.h"
+#include "ctags-generator.h"
+
+/*
+ * The watcher keeps a set of the files which changed under a source 
+ * folder, whoever changed them, so that they can be tagged again without 
+ * waiting for the editor to save them. Every folder of the tree is 
+ * watched with a directory monitor, up to MAX_WATCHES folders; a larger 
+ * tree is scanned every POLL_INTERVAL seconds instead, comparing the 
+ * modification time of each file with that of the previous scan. The 
+ * folders are walked on a thread of their own, while the monitors are 
+ * created and report on the main loop. Hidden folders, such as those of 
+ * version control, are not watched. Symbolic links are followed, as the 
+ * generator does, with the folders of each walk remembered by device and 
+ * inode so that a link cycle ends. Only the files ctags would tag count 
+ * as changes, so a build writing objects into the tree goes unnoticed.
+ *
+ * The files under a folder which was deleted or moved away are not known 
+ * one by one, so those changes, and those lost when falling back to 
+ * scanning, are reported as a need to rebuild instead.
+ */
+
+typedef struct
+{
+  CtagsWatcher *watcher;
+  gchar        *folder_path;
+  GHashTable   *old_times;
+  GHashTable   *times;
+  GPtrArray    *folders;
+  GPtrArray    *changes;
+  GHashTable   *visited;
+  gint64        since;
+  gboolean      polling;
+} Scan;
+
+typedef struct
+{
+  const gchar *folder_path;
+  gsize        length;
+} FolderPrefix;
+
+#define MAX_WATCHES 2048
+#define POLL_INTERVAL 30
+
+static void ctags_watcher_class_init  (CtagsWatcherClass *klass);
+static void ctags_watcher_init        (CtagsWatcher      *watcher);
+static void ctags_watcher_finalize    (CtagsWatcher      *watcher);
+
+static gboolean start_scan            (CtagsWatcher      *watcher);
+static gpointer run_scan              (Scan              *scan);
+static void scan_folder               (Scan              *scan,
+                                       const gchar       *folder_path);
+static void compare_times             (Scan              *scan);
+static void find_newer                (Scan              *scan);
+static gboolean finish_scan           (Scan              *scan);
+static void start_polling             (CtagsWatcher      *watcher);
+static gboolean add_monitor           (CtagsWatcher      *watcher,
+                                       const gchar       *folder_path);
+static gboolean add_folder            (CtagsWatcher      *watcher,
+                                       const gchar       *folder_path,
+                                       GHashTable        *visited);
+static void remove_folder             (CtagsWatcher      *watcher,
+                                       const gchar       *folder_path);
+static gboolean has_prefix            (const gchar       *key,
+                                       gpointer           value,
+                                       FolderPrefix      *prefix);
+static void monitor_changed_action    (GFileMonitor      *monitor,
+                                       GFile             *file,
+                                       GFile             *other_file,
+                                       GFileMonitorEvent  event_type,
+                                       CtagsWatcher      *watcher);
+static void file_created              (CtagsWatcher      *watcher,
+                                       GFile             *file);
+static void file_deleted              (CtagsWatcher      *watcher,
+                                       GFile             *file);
+static void add_change                (CtagsWatcher      *watcher,
+                                       const gchar       *file_path);
+static gboolean is_hidden             (const gchar       *name);
+static gboolean visit_folder          (GHashTable        *visited,
+                                       const gchar       *folder_path);
+
+#define CTAGS_WATCHER_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), CTAGS_WATCHER_TYPE, CtagsWatcherPrivate))
+
+typedef struct _CtagsWatcherPrivate CtagsWatcherPrivate;
+
+struct _CtagsWatcherPrivate
+{
+  gchar      *folder_path;
+  GHashTable *monitors;
+  GHashTable *changes;
+  GHashTable *times;
+  gint64      since;
+  gboolean    rebuild;
+  gboolean    polling;
+  guint       poll_source_id;
+};
+
+enum
+{
+  CHANGED,
+  LAST_SIGNAL
+};
+
+static guint ctags_watcher_signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE (CtagsWatcher, ctags_watcher, G_TYPE_OBJECT)
+
+static void 
+ctags_watcher_class_init (CtagsWatcherClass *klass)
+{
+  ctags_watcher_signals[CHANGED] =
+    g_signal_new ("changed", 
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (CtagsWatcherClass, changed),
+                  NULL, NULL, 
+                  g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) ctags_watcher_finalize;
+  g_type_class_add_private (klass, sizeof (CtagsWatcherPrivate));
+}
+
+static void
+ctags_watcher_init (CtagsWatcher *watcher)
+{
+  CtagsWatcherPrivate *priv;
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  priv->folder_path = NULL;
+  priv->monitors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  priv->changes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  priv->times = NULL;
+  priv->since = -1;
+  priv->rebuild = FALSE;
+  priv->polling = FALSE;
+  priv->poll_source_id = 0;
+}
+
+static void
+ctags_watcher_finalize (CtagsWatcher *watcher)
+{
+  CtagsWatcherPrivate *priv;
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  
+  if (priv->poll_source_id != 0)
+    g_source_remove (priv->poll_source_id);
+
+  g_hash_table_destroy (priv->monitors);
+  g_hash_table_destroy (priv->changes);
+  
+  if (priv->times != NULL)
+    g_hash_table_destroy (priv->times);
+
+  g_free (priv->folder_path);
+      
+  G_OBJECT_CLASS (ctags_watcher_parent_class)->finalize (G_OBJECT (watcher));
+}
+
+/*
+ * Starts watching the folder, which takes effect once it has been walked 
+ * in the background. Unless since is negative, the files modified at or 
+ * after that time, in seconds, are reported as changed by the first walk.
+ */
+CtagsWatcher*
+ctags_watcher_new (const gchar *folder_path,
+                   gint64       since)
+{
+  CtagsWatcherPrivate *priv;
+  CtagsWatcher *watcher;
+  watcher = CTAGS_WATCHER (g_object_new (ctags_watcher_get_type (), NULL));
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  priv->folder_path = g_strdup (folder_path);
+  priv->since = since;
+  start_scan (watcher);
+  return watcher;
+}
+
+/*
+ * Returns the files changed since the last call, to be freed by the 
+ * caller, and sets rebuild if some changes could not be told file by file.
+ */
+GList*
+ctags_watcher_take_changes (CtagsWatcher *watcher,
+                            gboolean     *rebuild)
+{
+  CtagsWatcherPrivate *priv;
+  GList *changes;
+  
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  
+  changes = g_hash_table_get_keys (priv->changes);
+  g_hash_table_steal_all (priv->changes);
+  
+  *rebuild = priv->rebuild;
+  priv->rebuild = FALSE;
+  
+  return changes;
+}
+
+gboolean
+ctags_watcher_is_polling (CtagsWatcher *watcher)
+{
+  return CTAGS_WATCHER_GET_PRIVATE (watcher)->polling;
+}
+
+static gboolean
+start_scan (CtagsWatcher *watcher)
+{
+  CtagsWatcherPrivate *priv;
+  GThread *thread;
+  Scan *scan;
+  
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  
+  priv->poll_source_id = 0;
+  
+  scan = g_slice_new0 (Scan);
+  scan->watcher = g_object_ref (watcher);
+  scan->folder_path = g_strdup (priv->folder_path);
+  scan->old_times = priv->times;
+  scan->times = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  scan->folders = g_ptr_array_new_with_free_func (g_free);
+  scan->changes = g_ptr_array_new_with_free_func (g_free);
+  scan->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  scan->since = priv->since;
+  scan->polling = priv->polling;
+  
+  priv->times = NULL;
+  priv->since = -1;
+  
+  thread = g_thread_new ("ctags-watcher", (GThreadFunc) run_scan, scan);
+  g_thread_unref (thread);
+  
+  return FALSE;
+}
+
+/*
+ * Runs on the scanning thread, which only ever touches the scan itself.
+ */
+static gpointer
+run_scan (Scan *scan)
+{
+  scan_folder (scan, scan->folder_path);
+  
+  if (scan->old_times != NULL)
+    compare_times (scan);
+  else if (scan->since >= 0)
+    find_newer (scan);
+  
+  g_idle_add ((GSourceFunc) finish_scan, scan);
+  
+  return NULL;
+}
+
+static void
+scan_folder (Scan        *scan,
+             const gchar *folder_path)
+{
+  const gchar *name;
+  GDir *dir;
+  
+  if (!visit_folder (scan->visited, folder_path))
+    return;
+  
+  if (!scan->polling)
+    {
+      if (scan->folders->len < MAX_WATCHES)
+        g_ptr_array_add (scan->folders, g_strdup (folder_path));
+      else
+        scan->polling = TRUE;
+    }
+  
+  dir = g_dir_open (folder_path, 0, NULL);
+  if (dir == NULL)
+    return;
+  
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      GStatBuf stat_buf;
+      gchar *file_path;
+      
+      file_path = g_build_filename (folder_path, name, NULL);
+      
+      if (g_stat (file_path, &stat_buf) == 0)
+        {
+          if (S_ISDIR (stat_buf.st_mode))
+            {
+              if (!is_hidden (name))
+                scan_folder (scan, file_path);
+            }
+          else if (S_ISREG (stat_buf.st_mode) && ctags_generator_is_source_file (file_path))
+            {
+              gint64 *time = g_new (gint64, 1);
+              *time = stat_buf.st_mtime;
+              g_hash_table_insert (scan->times, file_path, time);
+              file_path = NULL;
+            }
+        }
+      
+      g_free (file_path);
+    }
+  
+  g_dir_close (dir);
+}
+
+/*
+ * Lists the files which are new, gone or modified since the last scan.
+ */
+static void
+compare_times (Scan *scan)
+{
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  
+  g_hash_table_iter_init (&iter, scan->times);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      gint64 *old_time = g_hash_table_lookup (scan->old_times, key);
+      if (old_time == NULL || *old_time != *(gint64 *) value)
+        g_ptr_array_add (scan->changes, g_strdup (key));
+    }
+  
+  g_hash_table_iter_init (&iter, scan->old_times);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      if (!g_hash_table_contains (scan->times, key))
+        g_ptr_array_add (scan->changes, g_strdup (key));
+    }
+}
+
+/*
+ * Lists the files modified since the time given when the watcher was created.
+ */
+static void
+find_newer (Scan *scan)
+{
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  
+  g_hash_table_iter_init (&iter, scan->times);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      if (*(gint64 *) value >= scan->since)
+        g_ptr_array_add (scan->changes, g_strdup (key));
+    }
+}
+
+/*
+ * Back on the main loop, watches the folders found or keeps polling.
+ */
+static gboolean
+finish_scan (Scan *scan)
+{
+  CtagsWatcher *watcher = scan->watcher;
+  CtagsWatcherPrivate *priv;
+  guint i;
+  
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  
+  if (scan->polling)
+    {
+      priv->polling = TRUE;
+      priv->times = scan->times;
+      scan->times = NULL;
+      priv->poll_source_id = g_timeout_add_seconds_full (G_PRIORITY_LOW, POLL_INTERVAL,
+                                                         (GSourceFunc) start_scan, 
+                                                         watcher, NULL);
+    }
+  else
+    {
+      for (i = 0; i < scan->folders->len; i++)
+        add_monitor (watcher, g_ptr_array_index (scan->folders, i));
+    }
+  
+  for (i = 0; i < scan->changes->len; i++)
+    g_hash_table_add (priv->changes, g_strdup (g_ptr_array_index (scan->changes, i)));
+  
+  if (scan->changes->len > 0)
+    g_signal_emit_by_name ((gpointer) watcher, "changed");
+  
+  if (scan->old_times != NULL)
+    g_hash_table_destroy (scan->old_times);
+  if (scan->times != NULL)
+    g_hash_table_destroy (scan->times);
+  g_ptr_array_free (scan->folders, TRUE);
+  g_ptr_array_free (scan->changes, TRUE);
+  g_hash_table_destroy (scan->visited);
+  g_free (scan->folder_path);
+  g_slice_free (Scan, scan);
+  
+  g_object_unref (watcher);
+  
+  return FALSE;
+}
+
+/*
+ * Changes missed until the first scan ends are made up for by a rebuild.
+ */
+static void
+start_polling (CtagsWatcher *watcher)
+{
+  CtagsWatcherPrivate *priv;
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  
+  if (priv->polling)
+    return;
+  
+  priv->polling = TRUE;
+  priv->rebuild = TRUE;
+  g_hash_table_remove_all (priv->monitors);
+  start_scan (watcher);
+}
+
+static gboolean
+add_monitor (CtagsWatcher *watcher,
+             const gchar  *folder_path)
+{
+  CtagsWatcherPrivate *priv;
+  GFileMonitor *monitor;
+  GFile *folder;
+  
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  
+  if (g_hash_table_contains (priv->monitors, folder_path))
+    return TRUE;
+  
+  if (g_hash_table_size (priv->monitors) >= MAX_WATCHES)
+    return FALSE;
+  
+  folder = g_file_new_for_path (folder_path);
+  monitor = g_file_monitor_directory (folder, G_FILE_MONITOR_SEND_MOVED, NULL, NULL);
+  g_object_unref (folder);
+  
+  if (monitor == NULL)
+    return TRUE;
+  
+  g_signal_connect (G_OBJECT (monitor), "changed",
+                    G_CALLBACK (monitor_changed_action), watcher);
+  g_hash_table_insert (priv->monitors, g_strdup (folder_path), monitor);
+  
+  return TRUE;
+}
+
+/*
+ * Returns FALSE if that would take more than MAX_WATCHES monitors.
+ */
+static gboolean
+add_folder (CtagsWatcher *watcher,
+            const gchar  *folder_path,
+            GHashTable   *visited)
+{
+  const gchar *name;
+  gboolean result;
+  GDir *dir;
+  
+  if (!visit_folder (visited, folder_path))
+    return TRUE;
+  
+  result = add_monitor (watcher, folder_path);
+  
+  dir = g_dir_open (folder_path, 0, NULL);
+  if (dir == NULL)
+    return result;
+  
+  while (result && (name = g_dir_read_name (dir)) != NULL)
+    {
+      GStatBuf stat_buf;
+      gchar *file_path;
+      
+      file_path = g_build_filename (folder_path, name, NULL);
+      
+      if (g_stat (file_path, &stat_buf) == 0)
+        {
+          if (S_ISDIR (stat_buf.st_mode))
+            {
+              if (!is_hidden (name))
+                result = add_folder (watcher, file_path, visited);
+            }
+          else if (S_ISREG (stat_buf.st_mode))
+            {
+              add_change (watcher, file_path);
+            }
+        }
+      
+      g_free (file_path);
+    }
+  
+  g_dir_close (dir);
+  
+  return result;
+}
+
+static void
+remove_folder (CtagsWatcher *watcher,
+               const gchar  *folder_path)
+{
+  CtagsWatcherPrivate *priv;
+  FolderPrefix prefix;
+  
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  
+  prefix.folder_path = folder_path;
+  prefix.length = strlen (folder_path);
+  g_hash_table_foreach_remove (priv->monitors, (GHRFunc) has_prefix, &prefix);
+}
+
+static gboolean
+has_prefix (const gchar  *key,
+            gpointer      value,
+            FolderPrefix *prefix)
+{
+  return strncmp (key, prefix->folder_path, prefix->length) == 0 && 
+         (key[prefix->length] == '\0' || key[prefix->length] == G_DIR_SEPARATOR);
+}
+
+static void
+monitor_changed_action (GFileMonitor      *monitor,
+                        GFile             *file,
+                        GFile             *other_file,
+                        GFileMonitorEvent  event_type,
+                        CtagsWatcher      *watcher)
+{
+  CtagsWatcherPrivate *priv;
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  
+  switch (event_type)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGED:
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+      file_created (watcher, file);
+      break;
+    case G_FILE_MONITOR_EVENT_DELETED:
+      file_deleted (watcher, file);
+      break;
+    case G_FILE_MONITOR_EVENT_MOVED:
+      file_deleted (watcher, file);
+      if (other_file != NULL)
+        file_created (watcher, other_file);
+      break;
+    default:
+      return;
+    }
+  
+  if (priv->rebuild || g_hash_table_size (priv->changes) > 0)
+    g_signal_emit_by_name ((gpointer) watcher, "changed");
+}
+
+static void
+file_created (CtagsWatcher *watcher,
+              GFile        *file)
+{
+  CtagsWatcherPrivate *priv;
+  GHashTable *visited;
+  GStatBuf stat_buf;
+  gchar *file_path;
+  gchar *name;
+  
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  
+  file_path = g_file_get_path (file);
+  if (file_path == NULL)
+    return;
+  
+  if (g_stat (file_path, &stat_buf) == 0 && S_ISDIR (stat_buf.st_mode))
+    {
+      name = g_path_get_basename (file_path);
+      if (!is_hidden (name) && !g_hash_table_contains (priv->monitors, file_path))
+        {
+          visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+          if (!add_folder (watcher, file_path, visited))
+            start_polling (watcher);
+          g_hash_table_destroy (visited);
+        }
+      g_free (name);
+    }
+  else
+    {
+      add_change (watcher, file_path);
+    }
+  
+  g_free (file_path);
+}
+
+static void
+file_deleted (CtagsWatcher *watcher,
+              GFile        *file)
+{
+  CtagsWatcherPrivate *priv;
+  gchar *file_path;
+  
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  
+  file_path = g_file_get_path (file);
+  if (file_path == NULL)
+    return;
+  
+  if (g_hash_table_contains (priv->monitors, file_path))
+    {
+      remove_folder (watcher, file_path);
+      priv->rebuild = TRUE;
+    }
+  else
+    {
+      add_change (watcher, file_path);
+    }
+  
+  g_free (file_path);
+}
+
+static void
+add_change (CtagsWatcher *watcher,
+            const gchar  *file_path)
+{
+  CtagsWatcherPrivate *priv;
+  priv = CTAGS_WATCHER_GET_PRIVATE (watcher);
+  if (ctags_generator_is_source_file (file_path) && 
+      !g_hash_table_contains (priv->changes, file_path))
+    g_hash_table_add (priv->changes, g_strdup (file_path));
+}
+
+static gboolean
+is_hidden (const gchar *name)
+{
+  return name[0] == '.';
+}
+
+/*
+ * Returns FALSE if the folder cannot be read or was already visited.
+ */
+static gboolean
+visit_folder (GHashTable  *visited,
+              const gchar *folder_path)
+{
+  GStatBuf stat_buf;
+  gchar *key;
+  
+  if (g_stat (folder_path, &stat_buf) != 0)
+    return FALSE;
+  
+  key = g_strdup_printf ("%lu:%lu", (gulong) stat_buf.st_dev, 
+                         (gulong) stat_buf.st_ino);
+  if (g_hash_table_contains (visited, key))
+    {
+      g_free (key);
+      return FALSE;
+    }
+  
+  g_hash_table_add (visited, key);
+  return TRUE;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __CTAGS_WATCHER_H__
+#define	__CTAGS_WATCHER_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define CTAGS_WATCHER_TYPE            (ctags_watcher_get_type ())
+#define CTAGS_WATCHER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), CTAGS_WATCHER_TYPE, CtagsWatcher))
+#define CTAGS_WATCHER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), CTAGS_WATCHER_TYPE, CtagsWatcherClass))
+#define IS_CTAGS_WATCHER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), CTAGS_WATCHER_TYPE))
+#define IS_CTAGS_WATCHER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), CTAGS_WATCHER_TYPE))
+
+typedef struct _CtagsWatcher CtagsWatcher;
+typedef struct _CtagsWatcherClass CtagsWatcherClass;
+
+struct _CtagsWatcher
+{
+  GObject parent_instance;
+};
+
+struct _CtagsWatcherClass
+{
+  GObjectClass parent_class;
+  
+  void (*changed) (CtagsWatcher *watcher);
+};
+
+GType ctags_watcher_get_type (void) G_GNUC_CONST;
+
+CtagsWatcher*  ctags_watcher_new           (const gchar  *folder_path,
+                                            gint64        since);
+
+GList*         ctags_watcher_take_changes  (CtagsWatcher *watcher,
+                                            gboolean     *rebuild);
+gboolean       ctags_watcher_is_polling    (CtagsWatcher *watcher);
+
+G_END_DECLS
+
+#endif /* __CTAGS_WATCHER_H__ */
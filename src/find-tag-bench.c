@@ -0,0 +1,684 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Times Find Tag without the editor. The benchmark is compiled together 
+ * with the engine, so that it can go through the stages of a lookup one 
+ * by one, and runs it against a stub of the CodeSlayer API:
+ *
+ *   make find-tag-bench
+ *   ./find-tag-bench --projects 3 --lines 1000000 > find-tag.json
+ *   ./find-tag-bench --tags /path/to/project/tags
+ *   CTAGS_TRACE=find-tag.trace.json ./find-tag-bench --lookups 100
+ *
+ * The lookups are made for names sampled from the tags files, from a file 
+ * holding one of the matches some of the time so that every kind of 
+ * ranking is taken, and every few lookups go back and forward along the 
+ * path. The latency of each stage is printed as a JSON object of its own 
+ * line, with times in nanoseconds.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "ctags-engine.c"
+#include "codeslayer-stub.h"
+
+typedef enum
+{
+  STAGE_SELECTION,
+  STAGE_ORDER,
+  STAGE_OPEN,
+  STAGE_SEARCH,
+  STAGE_RANK,
+  STAGE_NAVIGATE,
+  STAGE_TOTAL,
+  STAGE_PREVIOUS,
+  STAGE_NEXT,
+  STAGES
+} Stage;
+
+typedef struct
+{
+  gchar *name;
+  gchar *file;
+  gint   line_number;
+} Sample;
+
+typedef struct _BenchWidget BenchWidget;
+typedef struct _BenchWidgetClass BenchWidgetClass;
+
+struct _BenchWidget
+{
+  GObject parent_instance;
+};
+
+struct _BenchWidgetClass
+{
+  GObjectClass parent_class;
+};
+
+#define HEADER_RATIO 0.2
+#define SAMPLES 65536
+
+static const gchar *stage_names[STAGES] = {
+  "selection", "order", "open", "search", "rank", "navigate", "total", 
+  "previous", "next"
+};
+
+static gchar **tag_files = NULL;
+static gint projects = 2;
+static gint lines = 200000;
+static gint lookups = 10000;
+static gdouble local_ratio = 0.3;
+static gdouble miss_ratio = 0.05;
+static gboolean ignore_case = FALSE;
+static gboolean warm = FALSE;
+static gint seed = 1;
+
+static GOptionEntry entries[] = {
+  { "tags", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &tag_files, 
+    "Tags file of a project, given once per project", "FILE" },
+  { "projects", 0, 0, G_OPTION_ARG_INT, &projects, 
+    "Projects to generate tags for, without --tags (2)", "N" },
+  { "lines", 0, 0, G_OPTION_ARG_INT, &lines, 
+    "Tags per generated project (200000)", "N" },
+  { "lookups", 'n', 0, G_OPTION_ARG_INT, &lookups, 
+    "Lookups to make (10000)", "N" },
+  { "local-ratio", 0, 0, G_OPTION_ARG_DOUBLE, &local_ratio, 
+    "Share of lookups made from a file holding a match (0.3)", "R" },
+  { "miss-ratio", 0, 0, G_OPTION_ARG_DOUBLE, &miss_ratio, 
+    "Share of lookups of names no project has (0.05)", "R" },
+  { "ignore-case", 0, 0, G_OPTION_ARG_NONE, &ignore_case, 
+    "Look up ignoring case, as Find Tag Ignore Case does", NULL },
+  { "warm-up", 0, 0, G_OPTION_ARG_NONE, &warm, 
+    "Warm up the tags before the first lookup", NULL },
+  { "seed", 0, 0, G_OPTION_ARG_INT, &seed, 
+    "Seed of the generated tags and the lookups (1)", "S" },
+  { NULL }
+};
+
+/*
+ * Stands in for both the menu and the project properties, which the 
+ * engine only connects to.
+ */
+G_DEFINE_TYPE (BenchWidget, bench_widget, G_TYPE_OBJECT)
+
+static void
+bench_widget_class_init (BenchWidgetClass *klass)
+{
+  const gchar *actions[] = { "find-tag", "find-tag-ignore-case", "find-symbol", 
+                             "rebuild-tags", "previous", "next", "show-statistics" };
+  guint i;
+  
+  for (i = 0; i < G_N_ELEMENTS (actions); i++)
+    g_signal_new (actions[i], G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+  
+  g_signal_new ("trace", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
+                0, NULL, NULL, g_cclosure_marshal_VOID__BOOLEAN, 
+                G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+  
+  g_signal_new ("save-config", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
+                0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT, 
+                G_TYPE_NONE, 1, G_TYPE_OBJECT);
+}
+
+static void
+bench_widget_init (BenchWidget *widget) 
+{
+}
+
+static guint64
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (guint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static gint
+compare_times (const guint64 *time1,
+               const guint64 *time2)
+{
+  return *time1 < *time2 ? -1 : *time1 > *time2;
+}
+
+static guint64
+percentile (GArray  *times,
+            gdouble  fraction)
+{
+  guint rank = (guint) (fraction * times->len + 0.999999);
+  rank = CLAMP (rank, 1, times->len);
+  return g_array_index (times, guint64, rank - 1);
+}
+
+/*
+ * Prints the distribution of the times of the stage, the first of which 
+ * is reported on its own since it includes opening the tags files.
+ */
+static void
+print_stage (Stage   stage,
+             GArray *times)
+{
+  guint64 first;
+  guint64 total = 0;
+  guint i;
+  
+  if (times->len == 0)
+    return;
+  
+  first = g_array_index (times, guint64, 0);
+  g_array_remove_index (times, 0);
+  
+  printf ("{\"metric\":\"stage\",\"stage\":\"%s\",\"count\":%u,\"first_ns\":%" 
+          G_GUINT64_FORMAT, stage_names[stage], times->len + 1, first);
+  
+  if (times->len > 0)
+    {
+      for (i = 0; i < times->len; i++)
+        total += g_array_index (times, guint64, i);
+      g_array_sort (times, (GCompareFunc) compare_times);
+      printf (",\"mean_ns\":%" G_GUINT64_FORMAT ",\"p50_ns\":%" G_GUINT64_FORMAT 
+              ",\"p90_ns\":%" G_GUINT64_FORMAT ",\"p99_ns\":%" G_GUINT64_FORMAT 
+              ",\"p999_ns\":%" G_GUINT64_FORMAT ",\"max_ns\":%" G_GUINT64_FORMAT,
+              total / times->len, 
+              percentile (times, 0.5), percentile (times, 0.9),
+              percentile (times, 0.99), percentile (times, 0.999),
+              g_array_index (times, guint64, times->len - 1));
+    }
+  
+  printf ("}\n");
+}
+
+static gint
+compare_strings (const gchar **string1,
+                 const gchar **string2)
+{
+  return strcmp (*string1, *string2);
+}
+
+static gchar*
+random_name (GRand *rand)
+{
+  const gchar *first = "ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz";
+  const gchar *rest = "ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz0123456789";
+  gint length = g_rand_int_range (rand, 4, 25);
+  gchar *name = g_new (gchar, length + 1);
+  gint i;
+  
+  name[0] = first[g_rand_int_range (rand, 0, strlen (first))];
+  for (i = 1; i < length; i++)
+    name[i] = rest[g_rand_int_range (rand, 0, strlen (rest))];
+  name[length] = '\0';
+  
+  return name;
+}
+
+/*
+ * Writes a sorted tags file whose tags are spread over the source files 
+ * of the folder, some of the names being declared in a header as well.
+ */
+static gboolean
+generate_tags (const gchar *file_path,
+               const gchar *source_folder,
+               GRand       *rand)
+{
+  GPtrArray *names;
+  GString *string;
+  gint files = lines / 64 + 1;
+  gint count = 0;
+  gboolean result;
+  guint i;
+  
+  names = g_ptr_array_new_with_free_func (g_free);
+  while (count < lines)
+    {
+      g_ptr_array_add (names, random_name (rand));
+      count += g_rand_double (rand) < HEADER_RATIO ? 2 : 1;
+    }
+  g_ptr_array_sort (names, (GCompareFunc) compare_strings);
+  
+  string = g_string_new ("!_TAG_FILE_FORMAT\t2\t/extended format/\n"
+                         "!_TAG_FILE_SORTED\t1\t/0=unsorted, 1=sorted, 2=foldcase/\n");
+  
+  for (i = 0; i < names->len; i++)
+    {
+      const gchar *name = g_ptr_array_index (names, i);
+      gint file = g_rand_int_range (rand, 0, files);
+      
+      if (g_rand_double (rand) < HEADER_RATIO)
+        g_string_append_printf (string, "%s\t%s/d%d/f%d.h\t/^%s (void);$/;\"\tp\tline:%d\n",
+                                name, source_folder, file / 32, file, name, 
+                                g_rand_int_range (rand, 1, 500));
+      
+      g_string_append_printf (string, "%s\t%s/d%d/f%d.c\t/^%s (void)$/;\"\tf\tline:%d\n",
+                              name, source_folder, file / 32, file, name, 
+                              g_rand_int_range (rand, 1, 5000));
+    }
+  
+  result = g_file_set_contents (file_path, string->str, string->len, NULL);
+  
+  g_string_free (string, TRUE);
+  g_ptr_array_free (names, TRUE);
+  
+  return result;
+}
+
+/*
+ * Picks tags to look up from the file, every tag being as likely to be 
+ * picked.
+ */
+static void
+sample_tags (const gchar *file_path,
+             GArray      *samples,
+             GRand       *rand)
+{
+  tagFileInfo info;
+  tagEntry entry;
+  tagFile *tag_file;
+  guint first = samples->len;
+  guint seen = 0;
+  
+  tag_file = tagsOpen (file_path, &info);
+  if (tag_file == NULL)
+    return;
+  
+  if (tagsFirst (tag_file, &entry) == TagSuccess)
+    {
+      do
+        {
+          Sample sample;
+          guint k = seen < SAMPLES ? seen : (guint) g_rand_int_range (rand, 0, seen + 1);
+          
+          seen++;
+          if (k >= SAMPLES)
+            continue;
+          
+          sample.name = g_strdup (entry.name);
+          sample.file = g_strdup (entry.file);
+          sample.line_number = entry.address.lineNumber;
+          
+          if (first + k < samples->len)
+            {
+              Sample *old = &g_array_index (samples, Sample, first + k);
+              g_free (old->name);
+              g_free (old->file);
+              *old = sample;
+            }
+          else
+            {
+              g_array_append_val (samples, sample);
+            }
+        }
+      while (tagsNext (tag_file, &entry) == TagSuccess);
+    }
+  
+  tagsClose (tag_file);
+}
+
+/*
+ * Adds a project tagged by the tags file. Its source folder is left empty, 
+ * so that nothing is ever tagged again while the lookups run.
+ */
+static gboolean
+add_project (CodeSlayer  *codeslayer,
+             const gchar *work_folder,
+             gint         number,
+             const gchar *tag_file_path,
+             GArray      *samples,
+             GRand       *rand)
+{
+  CodeSlayerProject *project;
+  GKeyFile *key_file;
+  gchar *name;
+  gchar *config_folder;
+  gchar *source_folder;
+  gchar *file_path;
+  gchar *data;
+  gboolean result = TRUE;
+  
+  name = g_strdup_printf ("project%d", number);
+  config_folder = g_build_filename (work_folder, "config", name, NULL);
+  source_folder = g_build_filename (work_folder, "source", name, NULL);
+  g_mkdir_with_parents (config_folder, 0700);
+  g_mkdir_with_parents (source_folder, 0700);
+  
+  project = codeslayer_stub_add_project (codeslayer, name, source_folder);
+  
+  key_file = g_key_file_new ();
+  g_key_file_set_string (key_file, MAIN, SOURCE_FOLDER, source_folder);
+  file_path = g_build_filename (config_folder, CTAGS_CONF, NULL);
+  data = g_key_file_to_data (key_file, NULL, NULL);
+  g_file_set_contents (file_path, data, -1, NULL);
+  g_free (data);
+  g_free (file_path);
+  g_key_file_free (key_file);
+  
+  file_path = g_build_filename (config_folder, TAGS, NULL);
+  if (tag_file_path != NULL)
+    {
+      gchar *current_dir = g_get_current_dir ();
+      gchar *absolute_path;
+      if (g_path_is_absolute (tag_file_path))
+        absolute_path = g_strdup (tag_file_path);
+      else
+        absolute_path = g_build_filename (current_dir, tag_file_path, NULL);
+      result = symlink (absolute_path, file_path) == 0;
+      g_free (absolute_path);
+      g_free (current_dir);
+    }
+  else
+    {
+      result = generate_tags (file_path, codeslayer_project_get_folder_path (project), rand);
+    }
+  
+  if (result)
+    sample_tags (file_path, samples, rand);
+  
+  g_free (file_path);
+  g_free (source_folder);
+  g_free (config_folder);
+  g_free (name);
+  
+  return result;
+}
+
+static void
+remove_tree (const gchar *folder_path)
+{
+  const gchar *name;
+  GDir *dir;
+  
+  dir = g_dir_open (folder_path, 0, NULL);
+  if (dir != NULL)
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          gchar *file_path = g_build_filename (folder_path, name, NULL);
+          if (g_file_test (file_path, G_FILE_TEST_IS_DIR) && 
+              !g_file_test (file_path, G_FILE_TEST_IS_SYMLINK))
+            remove_tree (file_path);
+          else
+            g_unlink (file_path);
+          g_free (file_path);
+        }
+      g_dir_close (dir);
+    }
+  
+  g_rmdir (folder_path);
+}
+
+static void
+run_pending (void)
+{
+  while (g_main_context_iteration (NULL, FALSE));
+}
+
+/*
+ * Selects the name in the buffer as the user would before pressing F4.
+ */
+static void
+set_selection (GtkTextBuffer *buffer,
+               const gchar   *name)
+{
+  GtkTextIter start;
+  GtkTextIter end;
+  gchar *text;
+  
+  text = g_strdup_printf ("  result = %s (data);\n", name);
+  gtk_text_buffer_set_text (buffer, text, -1);
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, 11);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, 11 + g_utf8_strlen (name, -1));
+  gtk_text_buffer_select_range (buffer, &start, &end);
+  g_free (text);
+}
+
+static void
+run_lookups (CtagsEngine *engine,
+             CodeSlayer  *codeslayer,
+             GArray      *samples,
+             GRand       *rand,
+             GArray     **times)
+{
+  GtkTextBuffer *buffer;
+  guint found = 0;
+  guint local = 0;
+  gint i;
+  
+  buffer = gtk_text_buffer_new (NULL);
+  
+  for (i = 0; i < lookups; i++)
+    {
+      Sample *sample;
+      Sample *from;
+      CodeSlayerDocument *document;
+      GList *search_order;
+      const tagMatch *match;
+      guint64 start[STAGES];
+      guint64 stop;
+      gchar *name;
+      gchar *text;
+      Stage stage;
+      
+      sample = &g_array_index (samples, Sample, g_rand_int_range (rand, 0, samples->len));
+      from = sample;
+      if (g_rand_double (rand) >= local_ratio)
+        from = &g_array_index (samples, Sample, g_rand_int_range (rand, 0, samples->len));
+      else
+        local++;
+      
+      if (g_rand_double (rand) < miss_ratio)
+        name = g_strconcat (sample->name, "~", NULL);
+      else
+        name = g_strdup (sample->name);
+      
+      set_selection (buffer, name);
+      codeslayer_stub_open_document (codeslayer, from->file, from->line_number);
+      
+      start[STAGE_SELECTION] = now ();
+      text = get_selection (buffer);
+      
+      start[STAGE_ORDER] = now ();
+      document = codeslayer_get_active_document (codeslayer);
+      search_order = get_search_order (engine, codeslayer_document_get_file_path (document));
+      
+      start[STAGE_OPEN] = now ();
+      open_tags (search_order);
+      
+      start[STAGE_SEARCH] = now ();
+      search_tags (search_order, text, ignore_case ? TAG_IGNORECASE : TAG_FULLMATCH);
+      
+      start[STAGE_RANK] = now ();
+      match = search_order != NULL ? rank_matches (search_order, document) : NULL;
+      
+      start[STAGE_NAVIGATE] = now ();
+      if (match != NULL)
+        {
+          select_document (engine, match);
+          found++;
+        }
+      stop = now ();
+      
+      start[STAGE_TOTAL] = start[STAGE_SELECTION];
+      for (stage = STAGE_SELECTION; stage <= STAGE_TOTAL; stage++)
+        {
+          guint64 time = (stage < STAGE_NAVIGATE ? start[stage + 1] : stop) - start[stage];
+          g_array_append_val (times[stage], time);
+        }
+      
+      /* go back two steps along the path and forward one */
+      if (i % 4 == 3)
+        {
+          guint64 time;
+          
+          time = now ();
+          previous_action (engine);
+          time = now () - time;
+          g_array_append_val (times[STAGE_PREVIOUS], time);
+          
+          time = now ();
+          previous_action (engine);
+          time = now () - time;
+          g_array_append_val (times[STAGE_PREVIOUS], time);
+          
+          time = now ();
+          next_action (engine);
+          time = now () - time;
+          g_array_append_val (times[STAGE_NEXT], time);
+        }
+      
+      g_list_free (search_order);
+      g_free (text);
+      g_free (name);
+      
+      run_pending ();
+    }
+  
+  printf ("{\"metric\":\"lookups\",\"count\":%d,\"found\":%u,\"local\":%u,\"selections\":%u}\n",
+          lookups, found, local, codeslayer_stub_get_selections (codeslayer));
+  
+  g_object_unref (buffer);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  CodeSlayer *codeslayer;
+  CtagsEngine *engine;
+  GObject *widget;
+  GArray *samples;
+  GArray *times[STAGES];
+  GRand *rand;
+  gchar *work_folder;
+  gchar *config_folder;
+  gint count;
+  gint i;
+  
+#if !GLIB_CHECK_VERSION (2, 35, 0)
+  g_type_init ();
+#endif
+  
+  context = g_option_context_new ("- time Find Tag without the editor");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+  
+  ctags_trace_init ();
+  
+  if (g_getenv (CTAGS_TRACE_VARIABLE) != NULL && 
+      !ctags_trace_start (g_getenv (CTAGS_TRACE_VARIABLE), &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  
+  if (lookups <= 0 || lines <= 0 || projects <= 0)
+    {
+      g_printerr ("find-tag-bench: counts must be positive\n");
+      return 1;
+    }
+  
+  work_folder = g_dir_make_tmp ("find-tag-bench-XXXXXX", &error);
+  if (work_folder == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  
+  rand = g_rand_new_with_seed (seed);
+  samples = g_array_new (FALSE, FALSE, sizeof (Sample));
+  
+  config_folder = g_build_filename (work_folder, "config", NULL);
+  codeslayer = codeslayer_stub_new (config_folder);
+  
+  count = tag_files != NULL ? (gint) g_strv_length (tag_files) : projects;
+  for (i = 0; i < count; i++)
+    {
+      if (!add_project (codeslayer, work_folder, i, 
+                        tag_files != NULL ? tag_files[i] : NULL, samples, rand))
+        {
+          g_printerr ("find-tag-bench: could not set up project %d\n", i);
+          remove_tree (work_folder);
+          return 1;
+        }
+    }
+  
+  if (samples->len == 0)
+    {
+      g_printerr ("find-tag-bench: no tags to look up\n");
+      remove_tree (work_folder);
+      return 1;
+    }
+  
+  printf ("{\"metric\":\"config\",\"projects\":%d,\"lines\":%d,\"tags_files\":%s,"
+          "\"lookups\":%d,\"local_ratio\":%g,\"miss_ratio\":%g,\"ignore_case\":%s,"
+          "\"warm_up\":%s,\"seed\":%d}\n",
+          count, tag_files != NULL ? 0 : lines, tag_files != NULL ? "true" : "false",
+          lookups, local_ratio, miss_ratio, ignore_case ? "true" : "false", 
+          warm ? "true" : "false", seed);
+  
+  widget = g_object_new (bench_widget_get_type (), NULL);
+  engine = ctags_engine_new (codeslayer, (GtkWidget *) widget, (GtkWidget *) widget);
+  
+  if (warm)
+    {
+      guint64 time = now ();
+      ctags_engine_warm_up (engine);
+      while (ctags_engine_get_warm_up_progress (engine) < 1.0)
+        g_main_context_iteration (NULL, TRUE);
+      printf ("{\"metric\":\"warm_up\",\"ns\":%" G_GUINT64_FORMAT "}\n", now () - time);
+    }
+  
+  for (i = 0; i < STAGES; i++)
+    times[i] = g_array_new (FALSE, FALSE, sizeof (guint64));
+  
+  run_lookups (engine, codeslayer, samples, rand, times);
+  
+  for (i = 0; i < STAGES; i++)
+    {
+      print_stage (i, times[i]);
+      g_array_free (times[i], TRUE);
+    }
+  
+  g_object_unref (engine);
+  g_object_unref (widget);
+  g_object_unref (codeslayer);
+  ctags_trace_stop ();
+  
+  for (i = 0; i < (gint) samples->len; i++)
+    {
+      g_free (g_array_index (samples, Sample, i).name);
+      g_free (g_array_index (samples, Sample, i).file);
+    }
+  g_array_free (samples, TRUE);
+  g_rand_free (rand);
+  
+  remove_tree (work_folder);
+  g_free (config_folder);
+  g_free (work_folder);
+  
+  return 0;
+}
@@ -0,0 +1,1105 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Generates synthetic tag files and measures the lookups of readtags 
+ * against them, so that changes to the search and parsing code can be 
+ * compared from one run to the next:
+ *
+ *   make readtags-bench
+ *   ./readtags-bench --lines 1M > before.json
+ *
+ * Given tag files on the command line it measures those instead. Every 
+ * result is printed on standard output as a JSON object of its own line, 
+ * with times in nanoseconds. Each file is generated, and then measured, 
+ * in a child process of its own so that the peak resident size reported 
+ * for a file is that of reading it alone. The files are measured just 
+ * after being written, so they are read from the page cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "readtags.h"
+
+typedef enum
+{
+  LENGTH_UNIFORM,
+  LENGTH_SHORT
+} LengthDist;
+
+typedef enum
+{
+  DUPLICATES_NONE,
+  DUPLICATES_UNIFORM,
+  DUPLICATES_ZIPF
+} DuplicateDist;
+
+typedef struct
+{
+  unsigned long  lines;
+  unsigned int   min_length;
+  unsigned int   max_length;
+  LengthDist     length_dist;
+  DuplicateDist  duplicate_dist;
+  unsigned int   max_duplicates;
+  unsigned int   queries;
+  unsigned int   slow_queries;
+  unsigned int   prefix_length;
+  double         miss_ratio;
+  unsigned long  seed;
+  const char    *dir;
+  const char    *sorts;
+  int            lazy;
+  int            keep;
+} Options;
+
+typedef struct
+{
+  const char *name;
+  int         options;
+} QueryKind;
+
+typedef struct
+{
+  char   *buffer;
+  size_t  length;
+  size_t  size;
+} Buffer;
+
+#define FIRST_CHARS "ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz"
+#define NAME_CHARS  "ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz0123456789"
+
+/* the tags sharing a name are spread over files of about this many tags */
+#define TAGS_PER_FILE 64
+
+static const QueryKind query_kinds[] = {
+  { "full",        TAG_FULLMATCH },
+  { "partial",     TAG_PARTIALMATCH },
+  { "ignore-case", TAG_FULLMATCH | TAG_IGNORECASE }
+};
+
+static unsigned long long random_state;
+
+static const char *sort_names;
+static const size_t *sort_offsets;
+
+/*
+ * xorshift64*, which is plenty for test data and the same on every 
+ * platform for a given seed.
+ */
+static unsigned long long
+next_random (void)
+{
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return random_state * 2685821657736338717ULL;
+}
+
+static void
+seed_random (unsigned long seed)
+{
+  random_state = (unsigned long long) seed ^ 0x9E3779B97F4A7C15ULL;
+  if (random_state == 0)
+    random_state = 1;
+}
+
+static unsigned long
+random_below (unsigned long n)
+{
+  return (unsigned long) (next_random () % n);
+}
+
+static double
+random_unit (void)
+{
+  return (next_random () >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static unsigned long long
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void*
+xmalloc (size_t size)
+{
+  void *result = malloc (size);
+  if (result == NULL)
+    {
+      perror ("readtags-bench");
+      exit (EXIT_FAILURE);
+    }
+  return result;
+}
+
+static void*
+xrealloc (void   *pointer,
+          size_t  size)
+{
+  void *result = realloc (pointer, size);
+  if (result == NULL)
+    {
+      perror ("readtags-bench");
+      exit (EXIT_FAILURE);
+    }
+  return result;
+}
+
+static void
+append (Buffer     *buffer,
+        const char *data,
+        size_t      length)
+{
+  if (buffer->length + length > buffer->size)
+    {
+      while (buffer->length + length > buffer->size)
+        buffer->size = buffer->size > 0 ? buffer->size * 2 : 4096;
+      buffer->buffer = xrealloc (buffer->buffer, buffer->size);
+    }
+  memcpy (buffer->buffer + buffer->length, data, length);
+  buffer->length += length;
+}
+
+/*
+ * Writes the string as a JSON string, quotes included.
+ */
+static void
+print_string (const char *string)
+{
+  const char *c;
+  putchar ('"');
+  for (c = string; *c != '\0'; c++)
+    {
+      if (*c == '"' || *c == '\\')
+        printf ("\\%c", *c);
+      else if ((unsigned char) *c < 0x20)
+        printf ("\\u%04x", (unsigned int) (unsigned char) *c);
+      else
+        putchar (*c);
+    }
+  putchar ('"');
+}
+
+static void
+print_start (const char *file_path,
+             const char *metric)
+{
+  printf ("{\"file\":");
+  print_string (file_path);
+  printf (",\"metric\":\"%s\"", metric);
+}
+
+static const char*
+sort_name (sortType sort)
+{
+  switch (sort)
+    {
+    case TAG_SORTED:
+      return "sorted";
+    case TAG_FOLDSORTED:
+      return "foldsorted";
+    default:
+      return "unsorted";
+    }
+}
+
+static unsigned int
+random_length (const Options *options)
+{
+  unsigned int length = options->min_length;
+  
+  if (options->length_dist == LENGTH_UNIFORM)
+    return length + random_below (options->max_length - options->min_length + 1);
+  
+  /* geometric, so that most names are short and a few are long */
+  while (length < options->max_length && random_unit () < 0.7)
+    length++;
+  
+  return length;
+}
+
+/*
+ * Zipf with an exponent of 2: a little over half the names are unique and 
+ * a few are shared by many tags, as main and init are in real projects.
+ */
+static unsigned int
+random_duplicates (const Options *options,
+                   const double  *zipf)
+{
+  unsigned int low = 0;
+  unsigned int high = options->max_duplicates - 1;
+  double target;
+  
+  switch (options->duplicate_dist)
+    {
+    case DUPLICATES_NONE:
+      return 1;
+    case DUPLICATES_UNIFORM:
+      return 1 + random_below (options->max_duplicates);
+    default:
+      break;
+    }
+  
+  target = random_unit () * zipf[high];
+  while (low < high)
+    {
+      unsigned int middle = low + (high - low) / 2;
+      if (zipf[middle] < target)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+  
+  return low + 1;
+}
+
+static int
+fold_compare (const char *s1,
+              const char *s2)
+{
+  int result;
+  do
+    result = toupper ((int) *s1) - toupper ((int) *s2);
+  while (result == 0 && *s1++ != '\0' && *s2++ != '\0');
+  return result;
+}
+
+static int
+compare_sorted (const void *a,
+                const void *b)
+{
+  return strcmp (sort_names + sort_offsets[*(const size_t *) a],
+                 sort_names + sort_offsets[*(const size_t *) b]);
+}
+
+/*
+ * Names which only differ in case are kept in byte order among themselves, 
+ * as "sort -f" would leave them with a stable sort.
+ */
+static int
+compare_folded (const void *a,
+                const void *b)
+{
+  const char *name1 = sort_names + sort_offsets[*(const size_t *) a];
+  const char *name2 = sort_names + sort_offsets[*(const size_t *) b];
+  int result = fold_compare (name1, name2);
+  return result != 0 ? result : strcmp (name1, name2);
+}
+
+static void
+write_line (FILE          *fp,
+            const char    *name,
+            unsigned long  files)
+{
+  unsigned long file = random_below (files);
+  fprintf (fp, "%s\tsrc/d%lu/f%lu.c\t/^%s (void)$/;\"\tf\tline:%lu\n",
+           name, file / 32, file, name, 1 + random_below (5000));
+}
+
+/*
+ * Writes a tag file of the given order with names drawn from the length 
+ * and duplicate distributions. Random names may happen to collide, which 
+ * only makes for a few more duplicates.
+ */
+static int
+generate (const Options *options,
+          sortType       sort,
+          const char    *file_path)
+{
+  Buffer names = { NULL, 0, 0 };
+  size_t *offsets = NULL;
+  unsigned int *copies = NULL;
+  size_t count = 0;
+  size_t capacity = 0;
+  unsigned long lines = 0;
+  unsigned long files;
+  double *zipf;
+  char name[256];
+  FILE *fp;
+  size_t i;
+  
+  seed_random (options->seed);
+  
+  zipf = xmalloc (options->max_duplicates * sizeof (double));
+  for (i = 0; i < options->max_duplicates; i++)
+    zipf[i] = (i > 0 ? zipf[i - 1] : 0) + 1.0 / ((double) (i + 1) * (i + 1));
+  
+  while (lines < options->lines)
+    {
+      unsigned int length = random_length (options);
+      unsigned int n = random_duplicates (options, zipf);
+      unsigned int j;
+      
+      if (n > options->lines - lines)
+        n = options->lines - lines;
+      
+      if (count == capacity)
+        {
+          capacity = capacity > 0 ? capacity * 2 : 65536;
+          offsets = xrealloc (offsets, capacity * sizeof (size_t));
+          copies = xrealloc (copies, capacity * sizeof (unsigned int));
+        }
+      
+      name[0] = FIRST_CHARS[random_below (sizeof (FIRST_CHARS) - 1)];
+      for (j = 1; j < length; j++)
+        name[j] = NAME_CHARS[random_below (sizeof (NAME_CHARS) - 1)];
+      name[length] = '\0';
+      
+      offsets[count] = names.length;
+      append (&names, name, length + 1);
+      copies[count++] = n;
+      lines += n;
+    }
+  
+  fp = fopen (file_path, "w");
+  if (fp == NULL)
+    {
+      perror (file_path);
+      return EXIT_FAILURE;
+    }
+  setvbuf (fp, NULL, _IOFBF, 1 << 20);
+  
+  fprintf (fp, "!_TAG_FILE_FORMAT\t2\t/extended format; --format=1 will not append ;\" to lines/\n");
+  fprintf (fp, "!_TAG_FILE_SORTED\t%d\t/0=unsorted, 1=sorted, 2=foldcase/\n", (int) sort);
+  fprintf (fp, "!_TAG_PROGRAM_NAME\treadtags-bench\t//\n");
+  
+  files = options->lines / TAGS_PER_FILE + 1;
+  
+  if (sort == TAG_UNSORTED)
+    {
+      size_t *order = xmalloc (lines * sizeof (size_t));
+      size_t line = 0;
+      
+      for (i = 0; i < count; i++)
+        {
+          unsigned int j;
+          for (j = 0; j < copies[i]; j++)
+            order[line++] = i;
+        }
+      
+      for (i = lines - 1; i > 0; i--)
+        {
+          size_t k = random_below (i + 1);
+          size_t swap = order[i];
+          order[i] = order[k];
+          order[k] = swap;
+        }
+      
+      for (i = 0; i < lines; i++)
+        write_line (fp, names.buffer + offsets[order[i]], files);
+      
+      free (order);
+    }
+  else
+    {
+      size_t *order = xmalloc (count * sizeof (size_t));
+      
+      for (i = 0; i < count; i++)
+        order[i] = i;
+      
+      sort_names = names.buffer;
+      sort_offsets = offsets;
+      qsort (order, count, sizeof (size_t), 
+             sort == TAG_SORTED ? compare_sorted : compare_folded);
+      
+      for (i = 0; i < count; i++)
+        {
+          unsigned int j;
+          for (j = 0; j < copies[order[i]]; j++)
+            write_line (fp, names.buffer + offsets[order[i]], files);
+        }
+      
+      free (order);
+    }
+  
+  if (fclose (fp) != 0)
+    {
+      perror (file_path);
+      return EXIT_FAILURE;
+    }
+  
+  free (zipf);
+  free (offsets);
+  free (copies);
+  free (names.buffer);
+  
+  return EXIT_SUCCESS;
+}
+
+static int
+compare_times (const void *a,
+               const void *b)
+{
+  unsigned long long time1 = *(const unsigned long long *) a;
+  unsigned long long time2 = *(const unsigned long long *) b;
+  return time1 < time2 ? -1 : time1 > time2;
+}
+
+static unsigned long long
+percentile (const unsigned long long *times,
+            size_t                    count,
+            double                    fraction)
+{
+  size_t rank = (size_t) (fraction * count + 0.999999);
+  if (rank == 0)
+    rank = 1;
+  if (rank > count)
+    rank = count;
+  return times[rank - 1];
+}
+
+/*
+ * Prints the distribution of the times, the first of which is reported on 
+ * its own since it includes building the sample or case-folded index that 
+ * later searches reuse.
+ */
+static void
+print_times (const char         *file_path,
+             const char         *metric,
+             const char         *kind,
+             unsigned long long *times,
+             size_t              count,
+             unsigned long       matches)
+{
+  unsigned long long total = 0;
+  size_t i;
+  
+  print_start (file_path, metric);
+  printf (",\"query\":\"%s\",\"queries\":%lu,\"matches\":%lu,\"first_ns\":%llu",
+          kind, (unsigned long) count, matches, times[0]);
+  
+  if (count > 1)
+    {
+      times++;
+      count--;
+      for (i = 0; i < count; i++)
+        total += times[i];
+      qsort (times, count, sizeof (unsigned long long), compare_times);
+      printf (",\"mean_ns\":%llu,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,"
+              "\"p999_ns\":%llu,\"max_ns\":%llu",
+              total / count,
+              percentile (times, count, 0.5), 
+              percentile (times, count, 0.9),
+              percentile (times, count, 0.99), 
+              percentile (times, count, 0.999),
+              times[count - 1]);
+    }
+  
+  printf ("}\n");
+}
+
+static void
+scan (tagFile    *file,
+      const char *file_path,
+      off_t       size,
+      int         lazy)
+{
+  unsigned long long start;
+  unsigned long long time;
+  unsigned long lines = 0;
+  tagEntry entry;
+  
+  tagsSetLazyFields (file, lazy);
+  
+  start = now ();
+  if (tagsFirst (file, &entry) == TagSuccess)
+    {
+      do
+        lines++;
+      while (tagsNext (file, &entry) == TagSuccess);
+    }
+  time = now () - start;
+  
+  if (time == 0)
+    time = 1;
+  
+  print_start (file_path, "scan");
+  printf (",\"lazy\":%s,\"lines\":%lu,\"ns\":%llu,\"lines_per_s\":%.0f,\"mb_per_s\":%.1f}\n",
+          lazy ? "true" : "false", lines, time,
+          lines * 1e9 / time, size * 1e9 / time / (1024 * 1024));
+}
+
+/*
+ * Picks names to look up from the file itself, every tag being as likely 
+ * to be picked, so that names shared by many tags are looked up more.
+ */
+static char**
+sample_names (tagFile      *file,
+              unsigned int  count)
+{
+  char **names = xmalloc (count * sizeof (char*));
+  unsigned long seen = 0;
+  tagEntry entry;
+  unsigned int i;
+  
+  if (tagsFirst (file, &entry) == TagSuccess)
+    {
+      do
+        {
+          if (seen < count)
+            {
+              names[seen] = strdup (entry.name);
+            }
+          else
+            {
+              unsigned long k = random_below (seen + 1);
+              if (k < count)
+                {
+                  free (names[k]);
+                  names[k] = strdup (entry.name);
+                }
+            }
+          seen++;
+        }
+      while (tagsNext (file, &entry) == TagSuccess);
+    }
+  
+  for (i = seen; i < count; i++)
+    names[i] = strdup (seen > 0 ? names[i % seen] : "main");
+  
+  return names;
+}
+
+/*
+ * Turns a sampled name into a query of the kind, some of them made to 
+ * miss by appending a character no name has.
+ */
+static void
+make_query (const Options   *options,
+            const QueryKind *kind,
+            const char      *name,
+            char            *query,
+            size_t           size)
+{
+  size_t length = strlen (name);
+  size_t i;
+  
+  if (length > size - 2)
+    length = size - 2;
+  
+  if (kind->options & TAG_PARTIALMATCH && length > options->prefix_length)
+    length = options->prefix_length;
+  
+  memcpy (query, name, length);
+  
+  if (kind->options & TAG_IGNORECASE)
+    {
+      for (i = 0; i < length; i++)
+        {
+          if (next_random () & 1)
+            query[i] = isupper ((unsigned char) query[i]) ? 
+                       tolower ((unsigned char) query[i]) : 
+                       toupper ((unsigned char) query[i]);
+        }
+    }
+  
+  if (random_unit () < options->miss_ratio)
+    query[length++] = '~';
+  
+  query[length] = '\0';
+}
+
+static void
+measure_queries (const Options    *options,
+                 tagFile          *file,
+                 const char       *file_path,
+                 sortType          sort,
+                 const QueryKind  *kind,
+                 char            **names)
+{
+  unsigned long long *find_times;
+  unsigned long long *next_times;
+  unsigned long long *all_times;
+  unsigned long matches = 0;
+  unsigned long all_matches = 0;
+  tagMatchSet set;
+  unsigned int count = options->queries;
+  unsigned int i;
+  char query[256];
+  tagEntry entry;
+  
+  /* these searches read the whole file */
+  if (sort == TAG_UNSORTED || 
+      (sort == TAG_FOLDSORTED && !(kind->options & TAG_IGNORECASE)))
+    {
+      if (count > options->slow_queries)
+        count = options->slow_queries;
+    }
+  
+  if (count == 0)
+    return;
+  
+  find_times = xmalloc (count * sizeof (unsigned long long));
+  next_times = xmalloc (count * sizeof (unsigned long long));
+  all_times = xmalloc (count * sizeof (unsigned long long));
+  memset (&set, 0, sizeof (set));
+  
+  for (i = 0; i < count; i++)
+    {
+      unsigned long long start;
+      unsigned long long found;
+      
+      make_query (options, kind, names[i], query, sizeof (query));
+      
+      start = now ();
+      if (tagsFind (file, &entry, query, kind->options) == TagSuccess)
+        {
+          found = now ();
+          matches++;
+          while (tagsFindNext (file, &entry) == TagSuccess)
+            matches++;
+        }
+      else
+        {
+          found = now ();
+        }
+      find_times[i] = found - start;
+      next_times[i] = now () - start;
+      
+      start = now ();
+      if (tagsFindAll (file, &set, query, kind->options) == TagSuccess)
+        all_matches += set.count;
+      all_times[i] = now () - start;
+    }
+  
+  print_times (file_path, "find", kind->name, find_times, count, matches);
+  print_times (file_path, "find_next", kind->name, next_times, count, matches);
+  print_times (file_path, "find_all", kind->name, all_times, count, all_matches);
+  
+  tagsFreeMatchSet (&set);
+  free (find_times);
+  free (next_times);
+  free (all_times);
+}
+
+static int
+measure (const Options *options,
+         const char    *file_path)
+{
+  unsigned long long start;
+  unsigned long long time;
+  struct rusage usage;
+  struct stat st;
+  tagFileInfo info;
+  tagFile *file;
+  char **names;
+  unsigned int i;
+  
+  if (stat (file_path, &st) != 0)
+    {
+      perror (file_path);
+      return EXIT_FAILURE;
+    }
+  
+  start = now ();
+  file = tagsOpen (file_path, &info);
+  time = now () - start;
+  
+  if (file == NULL)
+    {
+      fprintf (stderr, "%s: %s\n", file_path, strerror (info.status.error_number));
+      return EXIT_FAILURE;
+    }
+  
+  print_start (file_path, "open");
+  printf (",\"sort\":\"%s\",\"bytes\":%lld,\"ns\":%llu}\n",
+          sort_name (info.file.sort), (long long) st.st_size, time);
+  
+  scan (file, file_path, st.st_size, 0);
+  scan (file, file_path, st.st_size, 1);
+  
+  start = now ();
+  tagsVerifySort (file, &info);
+  time = now () - start;
+  
+  print_start (file_path, "verify_sort");
+  printf (",\"sort\":\"%s\",\"actual_sort\":\"%s\",\"ns\":%llu}\n",
+          sort_name (info.file.sort), sort_name (info.file.actualSort), time);
+  
+  seed_random (options->seed + 1);
+  names = sample_names (file, options->queries);
+  
+  tagsSetLazyFields (file, options->lazy);
+  
+  for (i = 0; i < sizeof (query_kinds) / sizeof (query_kinds[0]); i++)
+    measure_queries (options, file, file_path, info.file.actualSort, 
+                     &query_kinds[i], names);
+  
+  for (i = 0; i < options->queries; i++)
+    free (names[i]);
+  free (names);
+  
+  tagsClose (file);
+  
+  getrusage (RUSAGE_SELF, &usage);
+  print_start (file_path, "peak_rss");
+  printf (",\"kb\":%ld}\n", (long) usage.ru_maxrss);
+  
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Runs generate(), if generating, or else measure() in a child process 
+ * and waits for it.
+ */
+static int
+run_child (const Options *options,
+           int            generating,
+           sortType       sort,
+           const char    *file_path)
+{
+  pid_t pid;
+  int status;
+  
+  fflush (stdout);
+  fflush (stderr);
+  
+  pid = fork ();
+  if (pid < 0)
+    {
+      perror ("fork");
+      return EXIT_FAILURE;
+    }
+  
+  if (pid == 0)
+    {
+      if (generating)
+        exit (generate (options, sort, file_path));
+      exit (measure (options, file_path));
+    }
+  
+  while (waitpid (pid, &status, 0) < 0)
+    {
+      if (errno != EINTR)
+        return EXIT_FAILURE;
+    }
+  
+  return WIFEXITED (status) ? WEXITSTATUS (status) : EXIT_FAILURE;
+}
+
+static void
+usage (FILE *fp)
+{
+  fprintf (fp,
+    "Usage: readtags-bench [OPTION]... [TAGFILE]...\n"
+    "Generates tag files and measures lookups in them, or in the files given.\n"
+    "\n"
+    "  -n, --lines=N             tags per generated file (default 1M)\n"
+    "      --name-length=MIN-MAX length of the names (default 4-24)\n"
+    "      --name-dist=DIST      uniform or short (default uniform)\n"
+    "      --duplicates=DIST     tags per name: none, uniform or zipf (default zipf)\n"
+    "      --max-duplicates=K    most tags sharing one name (default 32)\n"
+    "      --sort=LIST           orders to generate, from sorted, foldsorted and\n"
+    "                            unsorted (default all three)\n"
+    "  -q, --queries=N           lookups of each kind (default 10000)\n"
+    "      --slow-queries=N      lookups of each kind which read the whole file\n"
+    "                            (default 20)\n"
+    "      --prefix-length=N     length of partial match queries (default 4)\n"
+    "      --miss-ratio=R        share of queries matching nothing (default 0.1)\n"
+    "      --lazy                defer parsing extension fields while looking up\n"
+    "      --seed=S              seed of the generated data and queries (default 1)\n"
+    "      --dir=DIR             where to write the files (default $TMPDIR or /tmp)\n"
+    "      --keep                keep the generated files\n"
+    "  -h, --help                show this help\n"
+    "\n"
+    "Counts take a k or M suffix. Results are printed as JSON, one object per line.\n");
+}
+
+static int
+parse_count (const char    *string,
+             unsigned long *count)
+{
+  char *end;
+  unsigned long value;
+  
+  errno = 0;
+  value = strtoul (string, &end, 10);
+  if (errno != 0 || end == string)
+    return 0;
+  
+  if (*end == 'k' || *end == 'K')
+    {
+      value *= 1000;
+      end++;
+    }
+  else if (*end == 'm' || *end == 'M')
+    {
+      value *= 1000000;
+      end++;
+    }
+  
+  if (*end != '\0')
+    return 0;
+  
+  *count = value;
+  return 1;
+}
+
+static int
+parse_uint (const char   *string,
+            unsigned int *value)
+{
+  unsigned long count;
+  if (!parse_count (string, &count) || count > 0xFFFFFFFFUL)
+    return 0;
+  *value = (unsigned int) count;
+  return 1;
+}
+
+static int
+parse_sort (const char *string,
+            size_t      length,
+            sortType   *sort)
+{
+  if (length == 6 && strncmp (string, "sorted", length) == 0)
+    *sort = TAG_SORTED;
+  else if (length == 10 && strncmp (string, "foldsorted", length) == 0)
+    *sort = TAG_FOLDSORTED;
+  else if (length == 8 && strncmp (string, "unsorted", length) == 0)
+    *sort = TAG_UNSORTED;
+  else
+    return 0;
+  return 1;
+}
+
+static int
+parse_options (int      argc,
+               char   **argv,
+               Options *options)
+{
+  static const struct option long_options[] = {
+    { "lines",          required_argument, NULL, 'n' },
+    { "name-length",    required_argument, NULL, 'L' },
+    { "name-dist",      required_argument, NULL, 'D' },
+    { "duplicates",     required_argument, NULL, 'd' },
+    { "max-duplicates", required_argument, NULL, 'K' },
+    { "sort",           required_argument, NULL, 's' },
+    { "queries",        required_argument, NULL, 'q' },
+    { "slow-queries",   required_argument, NULL, 'Q' },
+    { "prefix-length",  required_argument, NULL, 'p' },
+    { "miss-ratio",     required_argument, NULL, 'm' },
+    { "lazy",           no_argument,       NULL, 'z' },
+    { "seed",           required_argument, NULL, 'S' },
+    { "dir",            required_argument, NULL, 'o' },
+    { "keep",           no_argument,       NULL, 'k' },
+    { "help",           no_argument,       NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  const char *list;
+  int c;
+  
+  while ((c = getopt_long (argc, argv, "n:q:h", long_options, NULL)) != -1)
+    {
+      int ok = 1;
+      char *end;
+      
+      switch (c)
+        {
+        case 'n':
+          ok = parse_count (optarg, &options->lines) && options->lines > 0;
+          break;
+        case 'L':
+          ok = sscanf (optarg, "%u-%u", &options->min_length, &options->max_length) == 2 &&
+               options->min_length > 0 && options->min_length <= options->max_length &&
+               options->max_length < 200;
+          break;
+        case 'D':
+          if (strcmp (optarg, "uniform") == 0)
+            options->length_dist = LENGTH_UNIFORM;
+          else if (strcmp (optarg, "short") == 0)
+            options->length_dist = LENGTH_SHORT;
+          else
+            ok = 0;
+          break;
+        case 'd':
+          if (strcmp (optarg, "none") == 0)
+            options->duplicate_dist = DUPLICATES_NONE;
+          else if (strcmp (optarg, "uniform") == 0)
+            options->duplicate_dist = DUPLICATES_UNIFORM;
+          else if (strcmp (optarg, "zipf") == 0)
+            options->duplicate_dist = DUPLICATES_ZIPF;
+          else
+            ok = 0;
+          break;
+        case 'K':
+          ok = parse_uint (optarg, &options->max_duplicates) && options->max_duplicates > 0;
+          break;
+        case 's':
+          for (list = optarg; ok && *list != '\0'; )
+            {
+              size_t length = strcspn (list, ",");
+              sortType sort;
+              ok = parse_sort (list, length, &sort);
+              list += length;
+              if (*list == ',')
+                list++;
+            }
+          options->sorts = optarg;
+          break;
+        case 'q':
+          ok = parse_uint (optarg, &options->queries) && options->queries > 0;
+          break;
+        case 'Q':
+          ok = parse_uint (optarg, &options->slow_queries);
+          break;
+        case 'p':
+          ok = parse_uint (optarg, &options->prefix_length) && options->prefix_length > 0;
+          break;
+        case 'm':
+          options->miss_ratio = strtod (optarg, &end);
+          ok = *end == '\0' && options->miss_ratio >= 0 && options->miss_ratio <= 1;
+          break;
+        case 'z':
+          options->lazy = 1;
+          break;
+        case 'S':
+          ok = parse_count (optarg, &options->seed);
+          break;
+        case 'o':
+          options->dir = optarg;
+          break;
+        case 'k':
+          options->keep = 1;
+          break;
+        case 'h':
+          usage (stdout);
+          exit (EXIT_SUCCESS);
+        default:
+          return 0;
+        }
+      
+      if (!ok)
+        {
+          fprintf (stderr, "readtags-bench: invalid argument '%s'\n", optarg);
+          return 0;
+        }
+    }
+  
+  return 1;
+}
+
+static void
+print_config (const Options *options)
+{
+  static const char *length_dists[] = { "uniform", "short" };
+  static const char *duplicate_dists[] = { "none", "uniform", "zipf" };
+  
+  printf ("{\"metric\":\"config\",\"lines\":%lu,\"name_length\":\"%u-%u\","
+          "\"name_dist\":\"%s\",\"duplicates\":\"%s\",\"max_duplicates\":%u,"
+          "\"queries\":%u,\"slow_queries\":%u,\"prefix_length\":%u,"
+          "\"miss_ratio\":%g,\"lazy\":%s,\"seed\":%lu}\n",
+          options->lines, options->min_length, options->max_length,
+          length_dists[options->length_dist], 
+          duplicate_dists[options->duplicate_dist],
+          options->max_duplicates, options->queries, options->slow_queries,
+          options->prefix_length, options->miss_ratio, 
+          options->lazy ? "true" : "false", options->seed);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Options options;
+  const char *list;
+  int result = EXIT_SUCCESS;
+  
+  options.lines = 1000000;
+  options.min_length = 4;
+  options.max_length = 24;
+  options.length_dist = LENGTH_UNIFORM;
+  options.duplicate_dist = DUPLICATES_ZIPF;
+  options.max_duplicates = 32;
+  options.queries = 10000;
+  options.slow_queries = 20;
+  options.prefix_length = 4;
+  options.miss_ratio = 0.1;
+  options.seed = 1;
+  options.dir = getenv ("TMPDIR");
+  options.sorts = "sorted,foldsorted,unsorted";
+  options.lazy = 0;
+  options.keep = 0;
+  
+  if (options.dir == NULL || *options.dir == '\0')
+    options.dir = "/tmp";
+  
+  if (!parse_options (argc, argv, &options))
+    {
+      usage (stderr);
+      return EXIT_FAILURE;
+    }
+  
+  print_config (&options);
+  
+  if (optind < argc)
+    {
+      int i;
+      for (i = optind; i < argc; i++)
+        {
+          if (run_child (&options, 0, TAG_UNSORTED, argv[i]) != EXIT_SUCCESS)
+            result = EXIT_FAILURE;
+        }
+      return result;
+    }
+  
+  for (list = options.sorts; *list != '\0'; )
+    {
+      size_t length = strcspn (list, ",");
+      char file_path[4096];
+      sortType sort;
+      
+      parse_sort (list, length, &sort);
+      list += length;
+      if (*list == ',')
+        list++;
+      
+      snprintf (file_path, sizeof (file_path), "%s/readtags-bench-%ld-%s.tags",
+                options.dir, (long) getpid (), sort_name (sort));
+      
+      fprintf (stderr, "readtags-bench: generating %s\n", file_path);
+      if (run_child (&options, 1, sort, file_path) != EXIT_SUCCESS)
+        {
+          unlink (file_path);
+          result = EXIT_FAILURE;
+          continue;
+        }
+      
+      fprintf (stderr, "readtags-bench: measuring %s\n", file_path);
+      if (run_child (&options, 0, sort, file_path) != EXIT_SUCCESS)
+        result = EXIT_FAILURE;
+      
+      if (!options.keep)
+        unlink (file_path);
+    }
+  
+  return result;
+}
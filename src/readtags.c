@@ -17,6 +17,19 @@
 #include <stdio.h>
 #include <errno.h>
 #include <sys/types.h>  /* to declare off_t */
+#if defined (__unix__)  ||  (defined (__APPLE__)  &&  defined (__MACH__))
+# include <unistd.h>
+#endif
+#if defined (_POSIX_MAPPED_FILES)  &&  _POSIX_MAPPED_FILES > 0
+# define READTAGS_MMAP 1
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+#if defined (__GNUC__)  &&  (defined (__x86_64__)  ||  defined (__i386__))
+# define READTAGS_SIMD 1
+# include <immintrin.h>
+#endif
 
 #include "readtags.h"
 
@@ -25,6 +38,36 @@
 */
 #define TAB '\t'
 
+/* Default amount of memory used for the sample of line positions and names
+ * which narrows binary searches (see tagsSetSampleBudget ())
+ */
+#define SAMPLE_BUDGET (1024 * 1024)
+
+/* Smallest distance between two sampled lines; tag files smaller than two
+ * such strides are not sampled at all
+ */
+#define SAMPLE_MIN_STRIDE 4096
+
+/* Number of tab positions recorded when scanning a line; lines with more
+ * tabs than this fall back to strchr () for the remaining ones
+ */
+#define MAX_SCAN_TABS 32
+
+/* Size of the blocks of storage for the strings of a match set; longer
+ * strings get a block to themselves
+ */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/* Default amount of memory used for the lines of each sorted run by
+ * tagsSortFile ()
+ */
+#define SORT_BUDGET (16 * 1024 * 1024)
+
+/* Largest number of runs merged at once by tagsSortFile (); more runs are
+ * merged in several passes
+ */
+#define MERGE_FANIN 16
+
 
 /*
 *   DATA DECLARATIONS
@@ -34,6 +77,66 @@ typedef struct {
 	char *buffer;
 } vstring;
 
+/* Boundaries found by a single scan of a line */
+typedef struct {
+		/* offset of the '\n' or '\0' ending the line, or of the end of data */
+	size_t end;
+		/* length of the line without its trailing line terminators */
+	size_t length;
+		/* offset of the first '\r' (`end' if none) */
+	size_t cr;
+		/* number of tabs in the line */
+	unsigned int tabCount;
+		/* offsets of the first MAX_SCAN_TABS tabs */
+	size_t tabs [MAX_SCAN_TABS];
+		/* first entry of `tabs' not yet consumed while parsing */
+	unsigned int nextTab;
+} lineScan;
+
+typedef void (*lineScanner) (const char *const line, const size_t length,
+							 lineScan *const scan);
+
+/* A line of the tag file while building the case-folded index */
+typedef struct {
+	off_t pos;
+	const char *name;
+} foldEntry;
+
+/* A sampled line of a sorted tag file */
+typedef struct {
+		/* file position of the first character of the line */
+	off_t pos;
+		/* offset of the tag name within the sample's `names' */
+	size_t name;
+} tagSample;
+
+/* A block of storage for the strings of an arena */
+typedef struct sArenaBlock {
+		/* next older block */
+	struct sArenaBlock *next;
+		/* bytes available in `data' */
+	size_t size;
+		/* bytes of `data' already handed out */
+	size_t used;
+	char data [1];
+} arenaBlock;
+
+/* A sorted stream of lines being merged */
+typedef struct {
+		/* stream the lines are read from */
+	FILE *fp;
+		/* position of the stream among the inputs of the merge */
+	int index;
+		/* current line of the stream, without its newline */
+	vstring line;
+} mergeInput;
+
+/* Storage for strings which are freed all at once */
+struct sTagArena {
+		/* blocks in use, most recent first */
+	arenaBlock *blocks;
+};
+
 /* Information about current tag file */
 struct sTagFile {
 		/* has the file been opened and this structure initialized? */
@@ -42,8 +145,21 @@ struct sTagFile {
 	short format;
 		/* how is the tag file sorted? */
 	sortType sortMethod;
-		/* pointer to file structure */
+		/* pointer to file structure (NULL when the file is memory mapped) */
 	FILE* fp;
+		/* memory mapped image of the tag file (NULL when read through `fp') */
+	const char *map;
+		/* length of the mapping, as passed to mmap () */
+	size_t mapSize;
+		/* read position within `map' */
+	off_t offset;
+		/* start and length of the last line read from `map' */
+	const char *mapLine;
+	size_t mapLineLength;
+		/* has `mapLine' been copied into `line' yet? */
+	short lineLoaded;
+		/* boundaries within the last line read */
+	lineScan scan;
 		/* file position of first character of `line' */
 	off_t pos;
 		/* size of tag file in seekable positions */
@@ -64,14 +180,76 @@ struct sTagFile {
 			short partial;
 				/* ignoring case */
 			short ignorecase;
+				/* matches are taken from the case-folded index */
+			short folded;
 	} search;
+		/* sample of every so many bytes of the file, used to narrow
+		 * the range of a binary search before touching the file */
+	struct {
+				/* memory which may be used for the sample */
+			size_t budget;
+				/* has the sample been built for the current file? */
+			short built;
+				/* size of the tag file the sample was built from */
+			off_t size;
+				/* number of entries in `list' */
+			size_t count;
+				/* sampled lines, in file order */
+			tagSample *list;
+				/* tag names of the sampled lines */
+			vstring names;
+	} sample;
+		/* positions of all lines ordered by case-folded name, which
+		 * lets case-insensitive searches of files not sorted that way
+		 * use a binary search as well */
+	struct {
+				/* has the index been built for the current file? */
+			short built;
+				/* size of the tag file the index was built from */
+			off_t size;
+				/* number of entries in `list' */
+			size_t count;
+				/* line positions, by folded name then position */
+			off_t *list;
+				/* positions of the lines matching the last search */
+			off_t *matches;
+				/* number of entries in `matches' */
+			size_t matchCount;
+				/* next entry of `matches' to be returned */
+			size_t next;
+	} fold;
 		/* miscellaneous extension fields */
 	struct {
 				/* number of entries in `list' */
 			unsigned short max;
 				/* list of key value pairs */
 			tagExtensionField *list;
+				/* open addressed table of `list' indexes (plus one) by
+				 * hash of key, rebuilt as each entry's fields are parsed */
+			unsigned short *slots;
+				/* number of entries in `slots' (a power of two) */
+			unsigned int slotCount;
+				/* value of the "line" field of the last entry parsed */
+			const char *line;
+				/* defer parsing until tagsField () is called */
+			short lazy;
 	} fields;
+		/* source file paths of the tags found by tagsFindAll (), each
+		 * stored once and numbered from zero in order of discovery */
+	struct {
+				/* storage for the paths */
+			struct sTagArena arena;
+				/* paths by number */
+			const char **list;
+				/* number of entries used and allocated in `list' */
+			unsigned int count;
+			unsigned int max;
+				/* open addressed table of path numbers (plus one) by
+				 * hash of path */
+			unsigned int *slots;
+				/* number of entries in `slots' (a power of two) */
+			unsigned int slotCount;
+	} paths;
 		/* buffers to be freed at close */
 	struct {
 			/* name of program author */
@@ -90,6 +268,16 @@ struct sTagFile {
 */
 const char *const EmptyString = "";
 const char *const PseudoTagPrefix = "!_";
+const char *const SortedPseudoTag = "!_TAG_FILE_SORTED\t";
+const char *const SortedPseudoLine =
+	"!_TAG_FILE_SORTED\t1\t/0=unsorted, 1=sorted, 2=foldcase/";
+
+/* Line scanning kernel, chosen for the processor by selectLineScanner () */
+static lineScanner LineScanner;
+
+/* Hook called around traced operations, set by tagsSetTraceHook () */
+static tagTraceHook TraceHook;
+static void *TraceData;
 
 /*
 *   FUNCTION DEFINITIONS
@@ -149,32 +337,282 @@ static int growString (vstring *s)
 	return result;
 }
 
-/* Copy name of tag out of tag line */
-static void copyName (tagFile *const file)
+/*
+*   LINE SCANNING
+*
+*   A line is scanned once, up to its terminating newline (or a null
+*   character), and the position of every tab, the first carriage return and
+*   the end of the line are recorded. The vector kernels test a whole block of
+*   bytes for all of these characters at once and only visit the few bytes
+*   that matched, so the name, fields and line length are found without the
+*   byte at a time strlen ()/strchr () passes.
+*/
+
+static void startScan (lineScan *const scan, const size_t length)
 {
-	size_t length;
-	const char *end = strchr (file->line.buffer, '\t');
-	if (end == NULL)
+	scan->end = length;
+	scan->cr = length;
+	scan->tabCount = 0;
+	scan->nextTab = 0;
+}
+
+/* Records a boundary character; returns 0 once the end of line is reached */
+static int noteBoundary (const char *const line, const size_t i,
+						 lineScan *const scan)
+{
+	int more = 1;
+	switch (line [i])
+	{
+		case TAB:
+			if (scan->tabCount < MAX_SCAN_TABS)
+				scan->tabs [scan->tabCount] = i;
+			++scan->tabCount;
+			break;
+		case '\r':
+			if (scan->cr == scan->end)
+				scan->cr = i;
+			break;
+		case '\n':
+		case '\0':
+			scan->end = i;
+			if (scan->cr > i)
+				scan->cr = i;
+			more = 0;
+			break;
+		default:
+			break;
+	}
+	return more;
+}
+
+static void scanTail (const char *const line, size_t i, const size_t length,
+					  lineScan *const scan)
+{
+	for (  ;  i < length  ;  ++i)
+	{
+		const char c = line [i];
+		if ((c == TAB  ||  c == '\r'  ||  c == '\n'  ||  c == '\0')  &&
+			! noteBoundary (line, i, scan))
+			break;
+	}
+}
+
+static void scanLineScalar (const char *const line, const size_t length,
+							lineScan *const scan)
+{
+	startScan (scan, length);
+	scanTail (line, 0, length, scan);
+}
+
+/*  The parsing the scanners replaced, with a pass over the line for its end,
+ *  another for a carriage return and one per tab, as strlen () and strchr ()
+ *  did. Only used as the baseline of the -B benchmark.
+ */
+static void scanLineBaseline (const char *const line, const size_t length,
+							  lineScan *const scan)
+{
+	const char *const newline = (const char*) memchr (line, '\n', length);
+	size_t limit = newline != NULL ? (size_t) (newline - line) : length;
+	const char *const null = (const char*) memchr (line, '\0', limit);
+	const char *cr;
+	const char *p = line;
+	const char *tab;
+	startScan (scan, length);
+	if (null != NULL)
+		limit = null - line;
+	if (limit < length)
+		scan->end = limit;
+	cr = (const char*) memchr (line, '\r', limit);
+	scan->cr = cr != NULL ? (size_t) (cr - line) : limit;
+	while ((tab = (const char*) memchr (p, TAB, limit - (p - line))) != NULL)
+	{
+		if (scan->tabCount < MAX_SCAN_TABS)
+			scan->tabs [scan->tabCount] = tab - line;
+		++scan->tabCount;
+		p = tab + 1;
+	}
+}
+
+#ifdef READTAGS_SIMD
+
+__attribute__ ((target ("sse2")))
+static void scanLineSSE2 (const char *const line, const size_t length,
+						  lineScan *const scan)
+{
+	const __m128i tab = _mm_set1_epi8 (TAB);
+	const __m128i cr = _mm_set1_epi8 ('\r');
+	const __m128i newline = _mm_set1_epi8 ('\n');
+	const __m128i null = _mm_setzero_si128 ();
+	size_t i;
+	startScan (scan, length);
+	for (i = 0  ;  i + 16 <= length  ;  i += 16)
+	{
+		const __m128i block = _mm_loadu_si128 ((const __m128i*) (line + i));
+		unsigned int mask = (unsigned int) _mm_movemask_epi8 (_mm_or_si128 (
+			_mm_or_si128 (_mm_cmpeq_epi8 (block, tab), _mm_cmpeq_epi8 (block, cr)),
+			_mm_or_si128 (_mm_cmpeq_epi8 (block, newline), _mm_cmpeq_epi8 (block, null))));
+		while (mask != 0)
+		{
+			if (! noteBoundary (line, i + __builtin_ctz (mask), scan))
+				return;
+			mask &= mask - 1;
+		}
+	}
+	scanTail (line, i, length, scan);
+}
+
+__attribute__ ((target ("avx2")))
+static void scanLineAVX2 (const char *const line, const size_t length,
+						  lineScan *const scan)
+{
+	const __m256i tab = _mm256_set1_epi8 (TAB);
+	const __m256i cr = _mm256_set1_epi8 ('\r');
+	const __m256i newline = _mm256_set1_epi8 ('\n');
+	const __m256i null = _mm256_setzero_si256 ();
+	size_t i;
+	startScan (scan, length);
+	for (i = 0  ;  i + 32 <= length  ;  i += 32)
+	{
+		const __m256i block = _mm256_loadu_si256 ((const __m256i*) (line + i));
+		unsigned int mask = (unsigned int) _mm256_movemask_epi8 (_mm256_or_si256 (
+			_mm256_or_si256 (_mm256_cmpeq_epi8 (block, tab), _mm256_cmpeq_epi8 (block, cr)),
+			_mm256_or_si256 (_mm256_cmpeq_epi8 (block, newline), _mm256_cmpeq_epi8 (block, null))));
+		while (mask != 0)
+		{
+			if (! noteBoundary (line, i + __builtin_ctz (mask), scan))
+				return;
+			mask &= mask - 1;
+		}
+	}
+	scanTail (line, i, length, scan);
+}
+
+#endif
+
+static void selectLineScanner (void)
+{
+	if (LineScanner == NULL)
+	{
+		lineScanner scanner = scanLineScalar;
+#ifdef READTAGS_SIMD
+		__builtin_cpu_init ();
+		if (__builtin_cpu_supports ("avx2"))
+			scanner = scanLineAVX2;
+		else if (__builtin_cpu_supports ("sse2"))
+			scanner = scanLineSSE2;
+#endif
+		LineScanner = scanner;
+	}
+}
+
+/* Drops trailing line terminators from the scanned length of `line' */
+static void trimScan (const char *const line, lineScan *const scan)
+{
+	size_t length = scan->end;
+	while (length > 0  &&  (line [length - 1] == '\n'  ||  line [length - 1] == '\r'))
+		--length;
+	scan->length = length;
+	if (scan->cr > length)
+		scan->cr = length;
+}
+
+/*  Returns the first tab at or after `p' in the line buffer, using the tab
+ *  positions recorded when the line was scanned.
+ */
+static char *findTab (tagFile *const file, char *const p)
+{
+	char *const line = file->line.buffer;
+	lineScan *const scan = &file->scan;
+	const size_t offset = p - line;
+	const unsigned int recorded = scan->tabCount < MAX_SCAN_TABS ?
+		scan->tabCount : MAX_SCAN_TABS;
+	char *result = NULL;
+	while (scan->nextTab < recorded  &&  scan->tabs [scan->nextTab] < offset)
+		++scan->nextTab;
+	if (scan->nextTab < recorded)
 	{
-		end = strchr (file->line.buffer, '\n');
-		if (end == NULL)
-			end = strchr (file->line.buffer, '\r');
+		if (scan->tabs [scan->nextTab] < scan->length)
+			result = line + scan->tabs [scan->nextTab];
 	}
-	if (end != NULL)
-		length = end - file->line.buffer;
+	else if (scan->tabCount > MAX_SCAN_TABS)
+		result = strchr (p, TAB);
+	return result;
+}
+
+/* Copy name of tag out of tag line */
+static void copyName (tagFile *const file, const char *const line)
+{
+	const lineScan *const scan = &file->scan;
+	size_t length;
+	if (scan->tabCount > 0  &&  scan->tabs [0] < scan->length)
+		length = scan->tabs [0];
 	else
-		length = strlen (file->line.buffer);
+		length = scan->cr;
 	while (length >= file->name.size)
 		growString (&file->name);
-	strncpy (file->name.buffer, file->line.buffer, length);
+	memcpy (file->name.buffer, line, length);
 	file->name.buffer [length] = '\0';
 }
 
+/*  Locates the next line of a memory mapped tag file by scanning the mapping
+ *  directly. Only the name is copied out here; the complete line is copied
+ *  into `line' by loadLine () once the caller actually parses the entry,
+ *  since parsing terminates the fields in place and the mapping is read-only.
+ */
+static int readTagLineMapped (tagFile *const file)
+{
+	int result = 0;
+	if (file->offset < file->size)
+	{
+		const char *const start = file->map + file->offset;
+		const size_t available = (size_t) (file->size - file->offset);
+		LineScanner (start, available, &file->scan);
+		if (file->scan.end == available)
+			file->offset = file->size;
+		else if (start [file->scan.end] == '\n')
+			file->offset += file->scan.end + 1;
+		else
+		{
+			/* line contains a null character: skip to its newline */
+			const char *const newline = (const char*) memchr (
+				start + file->scan.end, '\n', available - file->scan.end);
+			if (newline == NULL)
+				file->offset = file->size;
+			else
+				file->offset += (newline - start) + 1;
+		}
+		trimScan (start, &file->scan);
+		file->pos = start - file->map;
+		file->mapLine = start;
+		file->mapLineLength = file->scan.length;
+		file->lineLoaded = 0;
+		copyName (file, start);
+		result = 1;
+	}
+	return result;
+}
+
+/* Make the last line read available in `line' */
+static void loadLine (tagFile *const file)
+{
+	if (file->map != NULL  &&  ! file->lineLoaded)
+	{
+		while (file->mapLineLength >= file->line.size)
+			growString (&file->line);
+		memcpy (file->line.buffer, file->mapLine, file->mapLineLength);
+		file->line.buffer [file->mapLineLength] = '\0';
+		file->lineLoaded = 1;
+	}
+}
+
 static int readTagLineRaw (tagFile *const file)
 {
 	int result = 1;
 	int reReadLine;
 
+	if (file->map != NULL)
+		return readTagLineMapped (file);
+
 	/*  If reading the line places any character other than a null or a
 	 *  newline at the last character position in the buffer (one less than
 	 *  the buffer size), then we must resize the buffer and reattempt to read
@@ -206,17 +644,13 @@ static int readTagLineRaw (tagFile *const file)
 		}
 		else
 		{
-			size_t i = strlen (file->line.buffer);
-			while (i > 0  &&
-				   (file->line.buffer [i - 1] == '\n' || file->line.buffer [i - 1] == '\r'))
-			{
-				file->line.buffer [i - 1] = '\0';
-				--i;
-			}
+			LineScanner (file->line.buffer, file->line.size, &file->scan);
+			trimScan (file->line.buffer, &file->scan);
+			file->line.buffer [file->scan.length] = '\0';
 		}
 	} while (reReadLine  &&  result);
 	if (result)
-		copyName (file);
+		copyName (file, file->line.buffer);
 	return result;
 }
 
@@ -230,9 +664,53 @@ static int readTagLine (tagFile *const file)
 	return result;
 }
 
+/* FNV-1a hash of the first `length' characters of `key' */
+static unsigned int hashKey (const char *const key, const size_t length)
+{
+	unsigned int hash = 2166136261u;
+	size_t i;
+	for (i = 0  ;  i < length  ;  ++i)
+	{
+		hash ^= (unsigned char) key [i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*  Enters field `index' of `list' into `slots'. Fields are entered in order,
+ *  so the first of several fields with the same key is found first.
+ */
+static void hashField (tagFile *const file, const unsigned short index,
+					   const size_t keyLength)
+{
+	const unsigned int mask = file->fields.slotCount - 1;
+	unsigned int slot = hashKey (file->fields.list [index].key, keyLength) & mask;
+	while (file->fields.slots [slot] != 0)
+		slot = (slot + 1) & mask;
+	file->fields.slots [slot] = (unsigned short) (index + 1);
+}
+
+/* Sizes `slots' to keep the table at most half full once `list' is full */
+static int allocateSlots (tagFile *const file)
+{
+	unsigned int count = 1;
+	unsigned short *slots;
+	while (count < 2u * file->fields.max)
+		count *= 2;
+	slots = (unsigned short*) calloc (count, sizeof (unsigned short));
+	if (slots != NULL)
+	{
+		free (file->fields.slots);
+		file->fields.slots = slots;
+		file->fields.slotCount = count;
+	}
+	return slots != NULL;
+}
+
 static tagResult growFields (tagFile *const file)
 {
 	tagResult result = TagFailure;
+	unsigned short oldCount = file->fields.max;
 	unsigned short newCount = (unsigned short) 2 * file->fields.max;
 	tagExtensionField *newFields = (tagExtensionField*)
 			realloc (file->fields.list, newCount * sizeof (tagExtensionField));
@@ -240,17 +718,43 @@ static tagResult growFields (tagFile *const file)
 		perror ("too many extension fields");
 	else
 	{
+		unsigned short i;
 		file->fields.list = newFields;
 		file->fields.max = newCount;
-		result = TagSuccess;
+		if (allocateSlots (file))
+		{
+			for (i = 0  ;  i < oldCount  ;  ++i)
+				hashField (file, i, strlen (file->fields.list [i].key));
+			result = TagSuccess;
+		}
+		else
+		{
+			file->fields.max = oldCount;
+			perror ("too many extension fields");
+		}
 	}
 	return result;
 }
 
+static void finishFields (tagFile *const file, tagEntry *const entry)
+{
+	int i;
+	if (entry->fields.count > 0)
+		entry->fields.list = file->fields.list;
+	for (i = entry->fields.count  ;  i < file->fields.max  ;  ++i)
+	{
+		file->fields.list [i].key = NULL;
+		file->fields.list [i].value = NULL;
+	}
+}
+
 static void parseExtensionFields (tagFile *const file, tagEntry *const entry,
 								  char *const string)
 {
 	char *p = string;
+	memset (file->fields.slots, 0,
+			file->fields.slotCount * sizeof (unsigned short));
+	entry->pending.fields = NULL;
 	while (p != NULL  &&  *p != '\0')
 	{
 		while (*p == TAB)
@@ -259,7 +763,7 @@ static void parseExtensionFields (tagFile *const file, tagEntry *const entry,
 		{
 			char *colon;
 			char *field = p;
-			p = strchr (p, TAB);
+			p = findTab (file, p);
 			if (p != NULL)
 				*p++ = '\0';
 			colon = strchr (field, ':');
@@ -269,36 +773,48 @@ static void parseExtensionFields (tagFile *const file, tagEntry *const entry,
 			{
 				const char *key = field;
 				const char *value = colon + 1;
+				const int special = (colon - field == 4);
 				*colon = '\0';
-				if (strcmp (key, "kind") == 0)
+				if (special  &&  memcmp (key, "kind", 4) == 0)
 					entry->kind = value;
-				else if (strcmp (key, "file") == 0)
+				else if (special  &&  memcmp (key, "file", 4) == 0)
 					entry->fileScope = 1;
-				else if (strcmp (key, "line") == 0)
+				else if (special  &&  memcmp (key, "line", 4) == 0)
+				{
 					entry->address.lineNumber = atol (value);
-				else
+					file->fields.line = value;
+				}
+				else if (entry->fields.count < file->fields.max  ||
+						 growFields (file) == TagSuccess)
 				{
-					if (entry->fields.count == file->fields.max)
-						growFields (file);
 					file->fields.list [entry->fields.count].key = key;
 					file->fields.list [entry->fields.count].value = value;
+					hashField (file, entry->fields.count, (size_t) (colon - field));
 					++entry->fields.count;
 				}
 			}
 		}
 	}
+	finishFields (file, entry);
 }
 
 static void parseTagLine (tagFile *file, tagEntry *const entry)
 {
-	int i;
-	char *p = file->line.buffer;
-	char *tab = strchr (p, TAB);
+	char *p;
+	char *tab;
+
+	loadLine (file);
+	file->scan.nextTab = 0;
+	p = file->line.buffer;
+	tab = findTab (file, p);
 
 	entry->fields.list = NULL;
 	entry->fields.count = 0;
 	entry->kind = NULL;
 	entry->fileScope = 0;
+	entry->pending.file = file;
+	entry->pending.fields = NULL;
+	file->fields.line = NULL;
 
 	entry->name = p;
 	if (tab != NULL)
@@ -306,7 +822,7 @@ static void parseTagLine (tagFile *file, tagEntry *const entry)
 		*tab = '\0';
 		p = tab + 1;
 		entry->file = p;
-		tab = strchr (p, TAB);
+		tab = findTab (file, p);
 		if (tab != NULL)
 		{
 			int fieldsPresent;
@@ -343,17 +859,66 @@ static void parseTagLine (tagFile *file, tagEntry *const entry)
 			}
 			fieldsPresent = (strncmp (p, ";\"", 2) == 0);
 			*p = '\0';
-			if (fieldsPresent)
+			if (fieldsPresent  &&  file->fields.lazy)
+				entry->pending.fields = p + 2;
+			else if (fieldsPresent)
 				parseExtensionFields (file, entry, p + 2);
 		}
 	}
-	if (entry->fields.count > 0)
-		entry->fields.list = file->fields.list;
-	for (i = entry->fields.count  ;  i < file->fields.max  ;  ++i)
+	if (entry->pending.fields == NULL)
+		finishFields (file, entry);
+}
+
+/* Copies `length' characters of `string' into the arena */
+static const char *arenaCopy (struct sTagArena *const arena,
+							  const char *const string, const size_t length)
+{
+	arenaBlock *block = arena->blocks;
+	char *result = NULL;
+	if (block == NULL  ||  block->size - block->used <= length)
 	{
-		file->fields.list [i].key = NULL;
-		file->fields.list [i].value = NULL;
+		size_t size = ARENA_BLOCK_SIZE;
+		while (size <= length)
+			size *= 2;
+		block = (arenaBlock*) malloc (sizeof (arenaBlock) + size);
+		if (block == NULL)
+			perror ("arenaCopy");
+		else
+		{
+			block->next = arena->blocks;
+			block->size = size;
+			block->used = 0;
+			arena->blocks = block;
+		}
+	}
+	if (block != NULL)
+	{
+		result = block->data + block->used;
+		memcpy (result, string, length);
+		result [length] = '\0';
+		block->used += length + 1;
+	}
+	return result;
+}
+
+/* Empties the arena, keeping its oldest block for reuse */
+static void resetArena (struct sTagArena *const arena)
+{
+	while (arena->blocks != NULL  &&  arena->blocks->next != NULL)
+	{
+		arenaBlock *const next = arena->blocks->next;
+		free (arena->blocks);
+		arena->blocks = next;
 	}
+	if (arena->blocks != NULL)
+		arena->blocks->used = 0;
+}
+
+static void freeArena (struct sTagArena *const arena)
+{
+	resetArena (arena);
+	free (arena->blocks);
+	arena->blocks = NULL;
 }
 
 static char *duplicate (const char *str)
@@ -368,14 +933,36 @@ static char *duplicate (const char *str)
 	return result;
 }
 
+static off_t getPosition (tagFile *const file)
+{
+	off_t result;
+	if (file->map != NULL)
+		result = file->offset;
+	else
+		result = ftell (file->fp);
+	return result;
+}
+
+static int setPosition (tagFile *const file, const off_t pos)
+{
+	int result = 0;
+	if (file->map != NULL)
+		file->offset = pos;
+	else
+		result = fseek (file->fp, pos, SEEK_SET);
+	return result;
+}
+
 static void readPseudoTags (tagFile *const file, tagFileInfo *const info)
 {
-	fpos_t startOfLine;
+	off_t startOfLine = 0;
 	const size_t prefixLength = strlen (PseudoTagPrefix);
 	if (info != NULL)
 	{
 		info->file.format     = 1;
 		info->file.sort       = TAG_UNSORTED;
+		info->file.verified   = 0;
+		info->file.actualSort = TAG_UNSORTED;
 		info->program.author  = NULL;
 		info->program.name    = NULL;
 		info->program.url     = NULL;
@@ -383,10 +970,10 @@ static void readPseudoTags (tagFile *const file, tagFileInfo *const info)
 	}
 	while (1)
 	{
-		fgetpos (file->fp, &startOfLine);
+		startOfLine = getPosition (file);
 		if (! readTagLine (file))
 			break;
-		if (strncmp (file->line.buffer, PseudoTagPrefix, prefixLength) != 0)
+		if (strncmp (file->name.buffer, PseudoTagPrefix, prefixLength) != 0)
 			break;
 		else
 		{
@@ -418,37 +1005,73 @@ static void readPseudoTags (tagFile *const file, tagFileInfo *const info)
 			}
 		}
 	}
-	fsetpos (file->fp, &startOfLine);
+	setPosition (file, startOfLine);
 }
 
 static void gotoFirstLogicalTag (tagFile *const file)
 {
-	fpos_t startOfLine;
+	off_t startOfLine = 0;
 	const size_t prefixLength = strlen (PseudoTagPrefix);
-	rewind (file->fp);
+	setPosition (file, 0);
 	while (1)
 	{
-		fgetpos (file->fp, &startOfLine);
+		startOfLine = getPosition (file);
 		if (! readTagLine (file))
 			break;
-		if (strncmp (file->line.buffer, PseudoTagPrefix, prefixLength) != 0)
+		if (strncmp (file->name.buffer, PseudoTagPrefix, prefixLength) != 0)
 			break;
 	}
-	fsetpos (file->fp, &startOfLine);
+	setPosition (file, startOfLine);
+}
+
+/*  Maps the tag file into memory, which lets lines be located without any
+ *  stdio buffering or system calls. Returns 0 if the file cannot be mapped,
+ *  in which case the caller falls back to reading it through stdio.
+ */
+static int openMapped (tagFile *const file, const char *const filePath)
+{
+	int result = 0;
+#ifdef READTAGS_MMAP
+	const int fd = open (filePath, O_RDONLY);
+	if (fd >= 0)
+	{
+		struct stat st;
+		if (fstat (fd, &st) == 0  &&  S_ISREG (st.st_mode)  &&
+			st.st_size > 0  &&  (off_t) (size_t) st.st_size == st.st_size)
+		{
+			void *const map = mmap (NULL, (size_t) st.st_size, PROT_READ,
+									MAP_PRIVATE, fd, 0);
+			if (map != MAP_FAILED)
+			{
+				file->map = (const char*) map;
+				file->mapSize = (size_t) st.st_size;
+				file->size = st.st_size;
+				file->offset = 0;
+				result = 1;
+			}
+		}
+		close (fd);
+	}
+#endif
+	return result;
 }
 
 static tagFile *initialize (const char *const filePath, tagFileInfo *const info)
 {
 	tagFile *result = (tagFile*) calloc ((size_t) 1, sizeof (tagFile));
+	selectLineScanner ();
 	if (result != NULL)
 	{
 		growString (&result->line);
 		growString (&result->name);
 		result->fields.max = 20;
+		result->sample.budget = SAMPLE_BUDGET;
 		result->fields.list = (tagExtensionField*) calloc (
 			result->fields.max, sizeof (tagExtensionField));
-		result->fp = fopen (filePath, "r");
-		if (result->fp == NULL)
+		allocateSlots (result);
+		if (! openMapped (result, filePath))
+			result->fp = fopen (filePath, "r");
+		if (result->map == NULL  &&  result->fp == NULL)
 		{
 			free (result);
 			result = NULL;
@@ -456,9 +1079,12 @@ static tagFile *initialize (const char *const filePath, tagFileInfo *const info)
 		}
 		else
 		{
-			fseek (result->fp, 0, SEEK_END);
-			result->size = ftell (result->fp);
-			rewind (result->fp);
+			if (result->fp != NULL)
+			{
+				fseek (result->fp, 0, SEEK_END);
+				result->size = ftell (result->fp);
+				rewind (result->fp);
+			}
 			readPseudoTags (result, info);
 			info->status.opened = 1;
 			result->initialized = 1;
@@ -469,11 +1095,20 @@ static tagFile *initialize (const char *const filePath, tagFileInfo *const info)
 
 static void terminate (tagFile *const file)
 {
-	fclose (file->fp);
+#ifdef READTAGS_MMAP
+	if (file->map != NULL)
+		munmap ((void*) file->map, file->mapSize);
+#endif
+	if (file->fp != NULL)
+		fclose (file->fp);
 
 	free (file->line.buffer);
 	free (file->name.buffer);
 	free (file->fields.list);
+	free (file->fields.slots);
+	freeArena (&file->paths.arena);
+	free (file->paths.list);
+	free (file->paths.slots);
 
 	if (file->program.author != NULL)
 		free (file->program.author);
@@ -485,6 +1120,14 @@ static void terminate (tagFile *const file)
 		free (file->program.version);
 	if (file->search.name != NULL)
 		free (file->search.name);
+	if (file->sample.list != NULL)
+		free (file->sample.list);
+	if (file->sample.names.buffer != NULL)
+		free (file->sample.names.buffer);
+	if (file->fold.list != NULL)
+		free (file->fold.list);
+	if (file->fold.matches != NULL)
+		free (file->fold.matches);
 
 	memset (file, 0, sizeof (tagFile));
 
@@ -507,25 +1150,46 @@ static tagResult readNext (tagFile *const file, tagEntry *const entry)
 	return result;
 }
 
+/*  Looks up `key' among the fields of the entry, parsing them first if that
+ *  was deferred. Parsing fills in the entry, which the caller regards as
+ *  unchanged since it only completes what reading the entry left out.
+ */
 static const char *readFieldValue (
 	const tagEntry *const entry, const char *const key)
 {
+	tagFile *const file = entry->pending.file;
 	const char *result = NULL;
-	int i;
-	if (strcmp (key, "kind") == 0)
+	if (file != NULL  &&  entry->pending.fields != NULL)
+		parseExtensionFields (file, (tagEntry*) entry, entry->pending.fields);
+	if (file == NULL)
+		result = NULL;
+	else if (strcmp (key, "kind") == 0)
 		result = entry->kind;
 	else if (strcmp (key, "file") == 0)
 		result = EmptyString;
-	else for (i = 0  ;  i < entry->fields.count  &&  result == NULL  ;  ++i)
-		if (strcmp (entry->fields.list [i].key, key) == 0)
-			result = entry->fields.list [i].value;
+	else if (strcmp (key, "line") == 0)
+		result = file->fields.line;
+	else if (entry->fields.count > 0)
+	{
+		const size_t length = strlen (key);
+		const unsigned int mask = file->fields.slotCount - 1;
+		unsigned int slot = hashKey (key, length) & mask;
+		while (result == NULL  &&  file->fields.slots [slot] != 0)
+		{
+			const tagExtensionField *const field =
+				&file->fields.list [file->fields.slots [slot] - 1];
+			if (strcmp (field->key, key) == 0)
+				result = field->value;
+			slot = (slot + 1) & mask;
+		}
+	}
 	return result;
 }
 
 static int readTagLineSeek (tagFile *const file, const off_t pos)
 {
 	int result = 0;
-	if (fseek (file->fp, pos, SEEK_SET) == 0)
+	if (setPosition (file, pos) == 0)
 	{
 		result = readTagLine (file);  /* read probable partial line */
 		if (pos > 0  &&  result)
@@ -534,71 +1198,198 @@ static int readTagLineSeek (tagFile *const file, const off_t pos)
 	return result;
 }
 
-static int nameComparison (tagFile *const file)
+static int probeLine (tagFile *const file, const off_t pos)
+{
+	const tagTraceHook hook = TraceHook;
+	int result;
+	if (hook == NULL)
+		return readTagLineSeek (file, pos);
+	hook (TAG_TRACE_PROBE, 1, (long) pos, TraceData);
+	result = readTagLineSeek (file, pos);
+	hook (TAG_TRACE_PROBE, 0, (long) pos, TraceData);
+	return result;
+}
+
+static int compareName (tagFile *const file, const char *const name)
 {
 	int result;
 	if (file->search.ignorecase)
 	{
 		if (file->search.partial)
-			result = strnuppercmp (file->search.name, file->name.buffer,
+			result = strnuppercmp (file->search.name, name,
 					file->search.nameLength);
 		else
-			result = struppercmp (file->search.name, file->name.buffer);
+			result = struppercmp (file->search.name, name);
 	}
 	else
 	{
 		if (file->search.partial)
-			result = strncmp (file->search.name, file->name.buffer,
+			result = strncmp (file->search.name, name,
 					file->search.nameLength);
 		else
-			result = strcmp (file->search.name, file->name.buffer);
+			result = strcmp (file->search.name, name);
 	}
 	return result;
 }
 
-static void findFirstNonMatchBefore (tagFile *const file)
+static int nameComparison (tagFile *const file)
 {
-#define JUMP_BACK 512
-	int more_lines;
-	int comp;
-	off_t start = file->pos;
-	off_t pos = start;
-	do
-	{
-		if (pos < (off_t) JUMP_BACK)
-			pos = 0;
-		else
-			pos = pos - JUMP_BACK;
-		more_lines = readTagLineSeek (file, pos);
-		comp = nameComparison (file);
-	} while (more_lines  &&  comp == 0  &&  pos > 0  &&  pos < start);
+	return compareName (file, file->name.buffer);
 }
 
-static tagResult findFirstMatchBefore (tagFile *const file)
+static void discardSample (tagFile *const file)
 {
-	tagResult result = TagFailure;
-	int more_lines;
-	off_t start = file->pos;
-	findFirstNonMatchBefore (file);
-	do
-	{
-		more_lines = readTagLine (file);
-		if (nameComparison (file) == 0)
-			result = TagSuccess;
-	} while (more_lines  &&  result != TagSuccess  &&  file->pos < start);
+	if (file->sample.list != NULL)
+		free (file->sample.list);
+	file->sample.list = NULL;
+	file->sample.count = 0;
+	file->sample.built = 0;
+}
+
+/*  Records the position and name of the first complete line following every
+ *  `stride' bytes of the file. The stride is chosen so that the sample,
+ *  allowing for an average name length, fits within the memory budget.
+ */
+static void buildSample (tagFile *const file)
+{
+	const size_t entrySize = sizeof (tagSample) + 32;
+	size_t max;
+	size_t namesLength = 0;
+	off_t stride;
+	off_t pos;
+
+	discardSample (file);
+	file->sample.built = 1;
+	file->sample.size = file->size;
+	max = file->sample.budget / entrySize;
+	if (max < 2  ||  file->size < 2 * SAMPLE_MIN_STRIDE)
+		return;
+	stride = file->size / (off_t) max;
+	if (stride < SAMPLE_MIN_STRIDE)
+		stride = SAMPLE_MIN_STRIDE;
+	max = (size_t) (file->size / stride) + 1;
+	file->sample.list = (tagSample*) malloc (max * sizeof (tagSample));
+	if (file->sample.list == NULL)
+	{
+		perror ("buildSample");
+		return;
+	}
+	for (pos = 0  ;  pos < file->size  &&  file->sample.count < max  ;  pos += stride)
+	{
+		tagSample *const last = file->sample.count > 0 ?
+			&file->sample.list [file->sample.count - 1] : NULL;
+		size_t length;
+		if (! readTagLineSeek (file, pos))
+			break;
+		if (last != NULL  &&  file->pos <= last->pos)
+			continue;  /* line spans the whole stride */
+		length = strlen (file->name.buffer) + 1;
+		while (namesLength + length > file->sample.names.size)
+		{
+			if (! growString (&file->sample.names))
+			{
+				discardSample (file);
+				file->sample.built = 1;
+				return;
+			}
+		}
+		memcpy (file->sample.names.buffer + namesLength, file->name.buffer, length);
+		file->sample.list [file->sample.count].pos = file->pos;
+		file->sample.list [file->sample.count].name = namesLength;
+		++file->sample.count;
+		namesLength += length;
+	}
+}
+
+/*  Narrows the range of a binary search to lie between the last sampled line
+ *  sorting before the name searched for and the first sampled line sorting
+ *  after it. Sampled lines which match are left inside the range.
+ */
+static void narrowWithSample (tagFile *const file,
+							  off_t *const lower_limit, off_t *const upper_limit)
+{
+	const tagSample *const list = file->sample.list;
+	const char *const names = file->sample.names.buffer;
+	size_t low = 0;
+	size_t high = file->sample.count;
+	size_t first;
+
+	/* first sampled line which does not sort before the name */
+	while (low < high)
+	{
+		const size_t middle = low + (high - low) / 2;
+		if (compareName (file, names + list [middle].name) > 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	first = low;
+	/* first sampled line which sorts after the name */
+	high = file->sample.count;
+	while (low < high)
+	{
+		const size_t middle = low + (high - low) / 2;
+		if (compareName (file, names + list [middle].name) >= 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	if (first > 0)
+		*lower_limit = list [first - 1].pos;
+	if (low < file->sample.count)
+		*upper_limit = list [low].pos;
+}
+
+static void findFirstNonMatchBefore (tagFile *const file)
+{
+#define JUMP_BACK 512
+	int more_lines;
+	int comp;
+	off_t start = file->pos;
+	off_t pos = start;
+	do
+	{
+		if (pos < (off_t) JUMP_BACK)
+			pos = 0;
+		else
+			pos = pos - JUMP_BACK;
+		more_lines = readTagLineSeek (file, pos);
+		comp = nameComparison (file);
+	} while (more_lines  &&  comp == 0  &&  pos > 0  &&  pos < start);
+}
+
+static tagResult findFirstMatchBefore (tagFile *const file)
+{
+	tagResult result = TagFailure;
+	int more_lines;
+	off_t start = file->pos;
+	findFirstNonMatchBefore (file);
+	do
+	{
+		more_lines = readTagLine (file);
+		if (nameComparison (file) == 0)
+			result = TagSuccess;
+	} while (more_lines  &&  result != TagSuccess  &&  file->pos < start);
 	return result;
 }
 
-static tagResult findBinary (tagFile *const file)
+static tagResult searchBinary (tagFile *const file)
 {
 	tagResult result = TagFailure;
 	off_t lower_limit = 0;
 	off_t upper_limit = file->size;
 	off_t last_pos = 0;
-	off_t pos = upper_limit / 2;
+	off_t pos;
+	if (file->sample.built  &&  file->sample.size != file->size)
+		discardSample (file);
+	if (! file->sample.built)
+		buildSample (file);
+	if (file->sample.count > 0)
+		narrowWithSample (file, &lower_limit, &upper_limit);
+	pos = lower_limit + ((upper_limit - lower_limit) / 2);
 	while (result != TagSuccess)
 	{
-		if (! readTagLineSeek (file, pos))
+		if (! probeLine (file, pos))
 		{
 			/* in case we fell off end of file */
 			result = findFirstMatchBefore (file);
@@ -632,6 +1423,18 @@ static tagResult findBinary (tagFile *const file)
 	return result;
 }
 
+static tagResult findBinary (tagFile *const file)
+{
+	const tagTraceHook hook = TraceHook;
+	tagResult result;
+	if (hook == NULL)
+		return searchBinary (file);
+	hook (TAG_TRACE_SEARCH, 1, -1L, TraceData);
+	result = searchBinary (file);
+	hook (TAG_TRACE_SEARCH, 0, -1L, TraceData);
+	return result;
+}
+
 static tagResult findSequential (tagFile *const file)
 {
 	tagResult result = TagFailure;
@@ -646,6 +1449,193 @@ static tagResult findSequential (tagFile *const file)
 	return result;
 }
 
+static int foldEntryCompare (const void *a, const void *b)
+{
+	const foldEntry *const x = (const foldEntry*) a;
+	const foldEntry *const y = (const foldEntry*) b;
+	int result = struppercmp (x->name, y->name);
+	if (result == 0)
+		result = (x->pos < y->pos) ? -1 : (x->pos > y->pos);
+	return result;
+}
+
+static int positionCompare (const void *a, const void *b)
+{
+	const off_t x = *(const off_t*) a;
+	const off_t y = *(const off_t*) b;
+	return (x < y) ? -1 : (x > y);
+}
+
+static void discardFoldIndex (tagFile *const file)
+{
+	if (file->fold.list != NULL)
+		free (file->fold.list);
+	file->fold.list = NULL;
+	file->fold.count = 0;
+	file->fold.matchCount = 0;
+	file->fold.next = 0;
+	file->fold.built = 0;
+}
+
+/*  Reads every line of the file once, then orders the line positions by
+ *  the names folded to upper case, exactly as struppercmp () compares them.
+ *  The names are only kept while sorting.
+ */
+static void buildFoldIndex (tagFile *const file)
+{
+	vstring names;
+	size_t namesLength = 0;
+	size_t max = 1024;
+	size_t count = 0;
+	off_t *positions;
+	size_t *offsets;
+	int ok;
+
+	discardFoldIndex (file);
+	file->fold.built = 1;
+	file->fold.size = file->size;
+	memset (&names, 0, sizeof (names));
+	positions = (off_t*) malloc (max * sizeof (off_t));
+	offsets = (size_t*) malloc (max * sizeof (size_t));
+	ok = (positions != NULL  &&  offsets != NULL);
+	setPosition (file, 0);
+	while (ok  &&  readTagLine (file))
+	{
+		const size_t length = strlen (file->name.buffer) + 1;
+		if (count == max)
+		{
+			off_t *const newPositions = (off_t*) realloc (
+					positions, 2 * max * sizeof (off_t));
+			size_t *const newOffsets = (size_t*) realloc (
+					offsets, 2 * max * sizeof (size_t));
+			if (newPositions != NULL)
+				positions = newPositions;
+			if (newOffsets != NULL)
+				offsets = newOffsets;
+			ok = (newPositions != NULL  &&  newOffsets != NULL);
+			max *= 2;
+		}
+		while (ok  &&  namesLength + length > names.size)
+			ok = growString (&names);
+		if (ok)
+		{
+			memcpy (names.buffer + namesLength, file->name.buffer, length);
+			positions [count] = file->pos;
+			offsets [count] = namesLength;
+			namesLength += length;
+			++count;
+		}
+	}
+	if (ok  &&  count > 0)
+	{
+		foldEntry *const entries = (foldEntry*) malloc (count * sizeof (foldEntry));
+		size_t i;
+		ok = (entries != NULL);
+		if (ok)
+		{
+			for (i = 0  ;  i < count  ;  ++i)
+			{
+				entries [i].pos = positions [i];
+				entries [i].name = names.buffer + offsets [i];
+			}
+			qsort (entries, count, sizeof (foldEntry), foldEntryCompare);
+			for (i = 0  ;  i < count  ;  ++i)
+				positions [i] = entries [i].pos;
+			free (entries);
+		}
+	}
+	if (ok)
+	{
+		file->fold.list = positions;
+		file->fold.count = count;
+	}
+	else
+	{
+		perror ("buildFoldIndex");
+		free (positions);
+	}
+	free (offsets);
+	free (names.buffer);
+}
+
+/* Compares the name searched for with the name of the line at `pos' */
+static int foldComparison (tagFile *const file, const off_t pos)
+{
+	setPosition (file, pos);
+	readTagLine (file);
+	return nameComparison (file);
+}
+
+/*  Locates the range of the case-folded index matching the name searched
+ *  for and orders it by file position, so that matches are returned in the
+ *  same order as a sequential search would return them.
+ */
+static tagResult findFolded (tagFile *const file)
+{
+	tagResult result = TagFailure;
+	size_t low = 0;
+	size_t high;
+	size_t first;
+
+	if (file->fold.built  &&  file->fold.size != file->size)
+		discardFoldIndex (file);
+	if (! file->fold.built)
+		buildFoldIndex (file);
+	file->fold.matchCount = 0;
+	file->fold.next = 0;
+
+	high = file->fold.count;
+	while (low < high)
+	{
+		const size_t middle = low + (high - low) / 2;
+		if (foldComparison (file, file->fold.list [middle]) > 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	first = low;
+	high = file->fold.count;
+	while (low < high)
+	{
+		const size_t middle = low + (high - low) / 2;
+		if (foldComparison (file, file->fold.list [middle]) >= 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	if (low > first)
+	{
+		const size_t count = low - first;
+		off_t *const matches = (off_t*) realloc (file->fold.matches,
+				count * sizeof (off_t));
+		if (matches == NULL)
+			perror ("findFolded");
+		else
+		{
+			file->fold.matches = matches;
+			file->fold.matchCount = count;
+			memcpy (matches, file->fold.list + first, count * sizeof (off_t));
+			if (file->search.partial)
+				qsort (matches, count, sizeof (off_t), positionCompare);
+			result = TagSuccess;
+		}
+	}
+	return result;
+}
+
+/* Reads the next line matched by findFolded () */
+static tagResult nextFolded (tagFile *const file)
+{
+	tagResult result = TagFailure;
+	if (file->fold.next < file->fold.matchCount)
+	{
+		setPosition (file, file->fold.matches [file->fold.next++]);
+		if (readTagLine (file))
+			result = TagSuccess;
+	}
+	return result;
+}
+
 static tagResult find (tagFile *const file, tagEntry *const entry,
 					   const char *const name, const int options)
 {
@@ -656,9 +1646,13 @@ static tagResult find (tagFile *const file, tagEntry *const entry,
 	file->search.nameLength = strlen (name);
 	file->search.partial = (options & TAG_PARTIALMATCH) != 0;
 	file->search.ignorecase = (options & TAG_IGNORECASE) != 0;
-	fseek (file->fp, 0, SEEK_END);
-	file->size = ftell (file->fp);
-	rewind (file->fp);
+	file->search.folded = 0;
+	if (file->fp != NULL)
+	{
+		fseek (file->fp, 0, SEEK_END);
+		file->size = ftell (file->fp);
+	}
+	setPosition (file, 0);
 	if ((file->sortMethod == TAG_SORTED      && !file->search.ignorecase) ||
 		(file->sortMethod == TAG_FOLDSORTED  &&  file->search.ignorecase))
 	{
@@ -667,6 +1661,17 @@ static tagResult find (tagFile *const file, tagEntry *const entry,
 #endif
 		result = findBinary (file);
 	}
+	else if (file->search.ignorecase)
+	{
+#ifdef DEBUG
+		printf ("<performing case-folded index search>\n");
+#endif
+		file->search.folded = 1;
+		if (findFolded (file) == TagSuccess)
+			result = nextFolded (file);
+		else
+			result = TagFailure;
+	}
 	else
 	{
 #ifdef DEBUG
@@ -689,7 +1694,13 @@ static tagResult find (tagFile *const file, tagEntry *const entry,
 static tagResult findNext (tagFile *const file, tagEntry *const entry)
 {
 	tagResult result;
-	if ((file->sortMethod == TAG_SORTED      && !file->search.ignorecase) ||
+	if (file->search.folded)
+	{
+		result = nextFolded (file);
+		if (result == TagSuccess  &&  entry != NULL)
+			parseTagLine (file, entry);
+	}
+	else if ((file->sortMethod == TAG_SORTED      && !file->search.ignorecase) ||
 		(file->sortMethod == TAG_FOLDSORTED  &&  file->search.ignorecase))
 	{
 		result = tagsNext (file, entry);
@@ -705,13 +1716,596 @@ static tagResult findNext (tagFile *const file, tagEntry *const entry)
 	return result;
 }
 
+/*
+*   MATCH SETS
+*/
+
+/* Looks up the slot of `path' in the table of paths */
+static unsigned int pathSlot (const tagFile *const file, const char *const path)
+{
+	const unsigned int mask = file->paths.slotCount - 1;
+	unsigned int slot = hashKey (path, strlen (path)) & mask;
+	while (file->paths.slots [slot] != 0  &&
+			strcmp (file->paths.list [file->paths.slots [slot] - 1], path) != 0)
+		slot = (slot + 1) & mask;
+	return slot;
+}
+
+/* Makes room for another path, keeping the table at most half full */
+static int growPaths (tagFile *const file)
+{
+	int result = 1;
+	if (file->paths.count == file->paths.max)
+	{
+		const unsigned int max = file->paths.max == 0 ? 64 : 2 * file->paths.max;
+		const char **const list = (const char**) realloc (
+			file->paths.list, max * sizeof (const char*));
+		unsigned int *const slots = (unsigned int*) calloc (
+			2 * max, sizeof (unsigned int));
+		if (list != NULL)
+			file->paths.list = list;
+		if (list == NULL  ||  slots == NULL)
+		{
+			perror ("too many source files");
+			free (slots);
+			result = 0;
+		}
+		else
+		{
+			unsigned int i;
+			free (file->paths.slots);
+			file->paths.slots = slots;
+			file->paths.slotCount = 2 * max;
+			file->paths.max = max;
+			for (i = 0  ;  i < file->paths.count  ;  ++i)
+				file->paths.slots [pathSlot (file, file->paths.list [i])] = i + 1;
+		}
+	}
+	return result;
+}
+
+/*  Returns the number of `path', entering it into the table of paths on
+ *  first sight, or -1 if memory ran out.
+ */
+static int internPath (tagFile *const file, const char *const path)
+{
+	int result = -1;
+	if (file->paths.slotCount > 0)
+	{
+		const unsigned int slot = pathSlot (file, path);
+		if (file->paths.slots [slot] != 0)
+			result = (int) file->paths.slots [slot] - 1;
+	}
+	if (result < 0  &&  growPaths (file))
+	{
+		const char *const copy = arenaCopy (&file->paths.arena, path, strlen (path));
+		if (copy != NULL)
+		{
+			result = (int) file->paths.count;
+			file->paths.list [file->paths.count++] = copy;
+			file->paths.slots [pathSlot (file, copy)] = (unsigned int) result + 1;
+		}
+	}
+	return result;
+}
+
+/* Appends the entry to the set; returns 0 if memory ran out */
+static int addMatch (tagFile *const file, tagMatchSet *const set,
+					 const tagEntry *const entry, const char *const previousName)
+{
+	tagMatch *match;
+	int id;
+	int result = 1;
+	if (set->count == set->max)
+	{
+		const size_t max = set->max == 0 ? 64 : 2 * set->max;
+		tagMatch *const list = (tagMatch*) realloc (
+			set->list, max * sizeof (tagMatch));
+		if (list == NULL)
+		{
+			perror ("tagsFindAll");
+			result = 0;
+		}
+		else
+		{
+			set->list = list;
+			set->max = max;
+		}
+	}
+	if (result)
+	{
+		match = &set->list [set->count];
+		if (previousName != NULL  &&  strcmp (previousName, entry->name) == 0)
+			match->name = previousName;
+		else
+			match->name = arenaCopy (set->arena, entry->name, strlen (entry->name));
+		id = internPath (file, entry->file);
+		match->fileId = (unsigned int) id;
+		match->file = id < 0 ? NULL : file->paths.list [id];
+		match->lineNumber = entry->address.lineNumber;
+		if (match->lineNumber == 0)
+		{
+			const char *const line = readFieldValue (entry, "line");
+			if (line != NULL)
+				match->lineNumber = (unsigned long) atol (line);
+		}
+		result = (match->name != NULL  &&  match->file != NULL);
+		if (result)
+			++set->count;
+	}
+	return result;
+}
+
+static tagResult findAll (tagFile *const file, tagMatchSet *const set,
+						  const char *const name, const int options)
+{
+	tagEntry entry;
+	tagResult result;
+	int ok = 1;
+	set->count = 0;
+	if (set->arena == NULL)
+	{
+		set->arena = (struct sTagArena*) calloc (1, sizeof (struct sTagArena));
+		if (set->arena == NULL)
+			perror ("tagsFindAll");
+	}
+	if (set->arena == NULL)
+		result = TagFailure;
+	else
+	{
+		resetArena (set->arena);
+		result = find (file, &entry, name, options);
+		while (result == TagSuccess  &&  ok)
+		{
+			ok = addMatch (file, set, &entry, set->count > 0 ?
+					set->list [set->count - 1].name : NULL);
+			result = findNext (file, &entry);
+		}
+		result = set->count > 0 ? TagSuccess : TagFailure;
+	}
+	return result;
+}
+
+static void freeMatchSet (tagMatchSet *const set)
+{
+	if (set->arena != NULL)
+	{
+		freeArena (set->arena);
+		free (set->arena);
+	}
+	free (set->list);
+	memset (set, 0, sizeof (tagMatchSet));
+}
+
+/*
+*   SORT ORDER
+*
+*   Lookups trust the !_TAG_FILE_SORTED pseudo-tag to choose between binary
+*   and sequential searches. tagsVerifySort () checks the order of the names
+*   in one pass, and tagsSortFile () writes a copy sorted in C locale byte
+*   order by way of an external merge sort, so that files produced unsorted,
+*   or sorted under another locale, can still be searched in log time.
+*/
+
+static void verifySort (tagFile *const file, tagFileInfo *const info)
+{
+	vstring previous = { 0, NULL };
+	int sorted = 1;
+	int folded = 1;
+	int first = 1;
+	sortType actual;
+	gotoFirstLogicalTag (file);
+	while ((sorted  ||  folded)  &&  readTagLine (file))
+	{
+		const size_t length = strlen (file->name.buffer);
+		if (! first)
+		{
+			if (sorted  &&  strcmp (previous.buffer, file->name.buffer) > 0)
+				sorted = 0;
+			if (folded  &&  struppercmp (previous.buffer, file->name.buffer) > 0)
+				folded = 0;
+		}
+		while (length >= previous.size)
+			growString (&previous);
+		memcpy (previous.buffer, file->name.buffer, length + 1);
+		first = 0;
+	}
+	free (previous.buffer);
+
+	/* prefer the declared order when the names are in both orders */
+	if (file->sortMethod == TAG_FOLDSORTED  &&  folded)
+		actual = TAG_FOLDSORTED;
+	else if (sorted)
+		actual = TAG_SORTED;
+	else if (folded)
+		actual = TAG_FOLDSORTED;
+	else
+		actual = TAG_UNSORTED;
+
+	if (info != NULL)
+	{
+		info->file.sort = file->sortMethod;
+		info->file.verified = 1;
+		info->file.actualSort = actual;
+	}
+	file->sortMethod = actual;
+	discardSample (file);
+	gotoFirstLogicalTag (file);
+}
+
+/* Reads a line without its line terminators; returns 0 at end of file */
+static int readLine (FILE *const fp, vstring *const line)
+{
+	size_t length = 0;
+	int result = 0;
+	if (line->buffer == NULL)
+		growString (line);
+	while (fgets (line->buffer + length, (int) (line->size - length), fp) != NULL)
+	{
+		result = 1;
+		length += strlen (line->buffer + length);
+		if (length > 0  &&  line->buffer [length - 1] == '\n')
+			break;
+		if (length + 1 < line->size  ||  ! growString (line))
+			break;
+	}
+	while (length > 0  &&  (line->buffer [length - 1] == '\n'  ||
+							line->buffer [length - 1] == '\r'))
+		line->buffer [--length] = '\0';
+	return result;
+}
+
+static int compareInputs (const mergeInput *const a, const mergeInput *const b)
+{
+	int result = strcmp (a->line.buffer, b->line.buffer);
+	if (result == 0)
+		result = a->index - b->index;
+	return result;
+}
+
+/* Moves the input at `heap [i]' down the heap of inputs ordered by line */
+static void siftDown (mergeInput **const heap, const int count, int i)
+{
+	while (2 * i + 1 < count)
+	{
+		int least = 2 * i + 1;
+		mergeInput *swap;
+		if (least + 1 < count  &&  compareInputs (heap [least + 1], heap [least]) < 0)
+			++least;
+		if (compareInputs (heap [i], heap [least]) <= 0)
+			break;
+		swap = heap [i];
+		heap [i] = heap [least];
+		heap [least] = swap;
+		i = least;
+	}
+}
+
+/*  Merges the sorted streams `inputs' into `output', leaving out the lines
+ *  `exclude' (if not null) rejects. Equal lines are written in the order of
+ *  their inputs. Returns 0 if writing failed.
+ */
+static int mergeStreams (FILE **const inputs, const int count,
+						 FILE *const output, const tagLineFilter exclude,
+						 void *const data)
+{
+	mergeInput *const merge = (mergeInput*) calloc (
+		(size_t) count + 1, sizeof (mergeInput));
+	mergeInput **const heap = (mergeInput**) calloc (
+		(size_t) count + 1, sizeof (mergeInput*));
+	int ok = (merge != NULL  &&  heap != NULL);
+	int size = 0;
+	int i;
+	for (i = 0  ;  ok  &&  i < count  ;  ++i)
+	{
+		merge [i].fp = inputs [i];
+		merge [i].index = i;
+		if (readLine (merge [i].fp, &merge [i].line))
+			heap [size++] = &merge [i];
+	}
+	for (i = size / 2 - 1  ;  i >= 0  ;  --i)
+		siftDown (heap, size, i);
+	while (ok  &&  size > 0)
+	{
+		mergeInput *const least = heap [0];
+		if (exclude == NULL  ||  ! exclude (least->line.buffer, least->index, data))
+			ok = (fputs (least->line.buffer, output) != EOF  &&
+				  putc ('\n', output) != EOF);
+		if (! readLine (least->fp, &least->line))
+			heap [0] = heap [--size];
+		siftDown (heap, size, 0);
+	}
+	if (merge != NULL)
+		for (i = 0  ;  i < count  ;  ++i)
+			free (merge [i].line.buffer);
+	free (merge);
+	free (heap);
+	return ok  &&  ! ferror (output);
+}
+
+static int compareLines (const void *a, const void *b)
+{
+	return strcmp (*(const char *const *) a, *(const char *const *) b);
+}
+
+/* Sorts `count' lines and writes them to a new temporary file */
+static FILE *writeRun (char **const lines, const size_t count)
+{
+	FILE *const run = tmpfile ();
+	size_t i;
+	int ok = (run != NULL);
+	qsort (lines, count, sizeof (char*), compareLines);
+	for (i = 0  ;  ok  &&  i < count  ;  ++i)
+		ok = (fputs (lines [i], run) != EOF  &&  putc ('\n', run) != EOF);
+	if (ok)
+		ok = (fflush (run) == 0);
+	if (ok)
+		rewind (run);
+	else if (run != NULL)
+	{
+		fclose (run);
+		perror ("tagsSortFile");
+	}
+	return ok ? run : NULL;
+}
+
+/* Adds a run to the list of runs, which grows as needed */
+static int addRun (FILE ***const runs, int *const count, FILE *const run)
+{
+	FILE **const list = (FILE**) realloc (*runs, (*count + 1) * sizeof (FILE*));
+	int result = (list != NULL);
+	if (list != NULL)
+	{
+		*runs = list;
+		list [(*count)++] = run;
+	}
+	else
+		fclose (run);
+	return result;
+}
+
+/*  Splits `input' into sorted runs of at most about `budget' bytes of lines
+ *  each. The !_TAG_FILE_SORTED pseudo-tag is rewritten to declare the file
+ *  sorted, and `declared' is set if it was present at all.
+ */
+static int splitRuns (FILE *const input, const size_t budget,
+					  FILE ***const runs, int *const runCount, int *const declared)
+{
+	vstring line = { 0, NULL };
+	char *text = (char*) malloc (budget);
+	size_t textSize = budget;
+	size_t used = 0;
+	size_t *offsets = NULL;
+	char **lines = NULL;
+	size_t count = 0;
+	size_t max = 0;
+	int more = 1;
+	int ok = (text != NULL);
+	*declared = 0;
+	while (ok  &&  more)
+	{
+		const char *next;
+		size_t length = 0;
+		more = readLine (input, &line);
+		next = line.buffer;
+		if (more)
+		{
+			if (strncmp (next, SortedPseudoTag, strlen (SortedPseudoTag)) == 0)
+			{
+				next = SortedPseudoLine;
+				*declared = 1;
+			}
+			length = strlen (next);
+		}
+		if (count > 0  &&  (! more  ||  used + length + 1 > textSize))
+		{
+			/* the text may have moved since the offsets were taken */
+			size_t i;
+			FILE *run;
+			lines = (char**) realloc (lines, count * sizeof (char*));
+			ok = (lines != NULL);
+			for (i = 0  ;  ok  &&  i < count  ;  ++i)
+				lines [i] = text + offsets [i];
+			run = ok ? writeRun (lines, count) : NULL;
+			ok = (run != NULL  &&  addRun (runs, runCount, run));
+			count = 0;
+			used = 0;
+		}
+		if (ok  &&  more  &&  length > 0)
+		{
+			if (length + 1 > textSize)
+			{
+				/* a single line larger than the budget */
+				char *const larger = (char*) realloc (text, length + 1);
+				ok = (larger != NULL);
+				if (ok)
+				{
+					text = larger;
+					textSize = length + 1;
+				}
+			}
+			if (ok  &&  count == max)
+			{
+				size_t *const larger = (size_t*) realloc (offsets,
+					(max == 0 ? 1024 : 2 * max) * sizeof (size_t));
+				ok = (larger != NULL);
+				if (ok)
+				{
+					offsets = larger;
+					max = max == 0 ? 1024 : 2 * max;
+				}
+			}
+			if (ok)
+			{
+				memcpy (text + used, next, length + 1);
+				offsets [count++] = used;
+				used += length + 1;
+			}
+		}
+	}
+	if (! ok)
+		perror ("tagsSortFile");
+	free (line.buffer);
+	free (text);
+	free (offsets);
+	free (lines);
+	return ok;
+}
+
+static void closeRuns (FILE **const runs, const int count)
+{
+	int i;
+	for (i = 0  ;  i < count  ;  ++i)
+		fclose (runs [i]);
+	free (runs);
+}
+
+/* Merges runs MERGE_FANIN at a time until at most that many are left */
+static int reduceRuns (FILE ***const runs, int *const runCount)
+{
+	int ok = 1;
+	while (ok  &&  *runCount > MERGE_FANIN)
+	{
+		FILE **merged = NULL;
+		int mergedCount = 0;
+		int i;
+		for (i = 0  ;  ok  &&  i < *runCount  ;  i += MERGE_FANIN)
+		{
+			const int group = (*runCount - i < MERGE_FANIN) ?
+				*runCount - i : MERGE_FANIN;
+			FILE *const run = tmpfile ();
+			ok = (run != NULL  &&
+				  mergeStreams (*runs + i, group, run, NULL, NULL)  &&
+				  fflush (run) == 0);
+			if (run != NULL)
+			{
+				rewind (run);
+				ok = addRun (&merged, &mergedCount, run)  &&  ok;
+			}
+		}
+		closeRuns (*runs, *runCount);
+		*runs = merged;
+		*runCount = mergedCount;
+	}
+	return ok;
+}
+
+/*  Flushes `out' and, where the system allows, forces its data to disk, so
+ *  that once the file is renamed into place it cannot turn up truncated
+ *  after a crash.
+ */
+static int syncFile (FILE *const out)
+{
+	int ok = (fflush (out) == 0);
+#if defined (_POSIX_FSYNC)  &&  _POSIX_FSYNC > 0
+	if (ok)
+		ok = (fsync (fileno (out)) == 0);
+#endif
+	return ok;
+}
+
+/*  Merges `inputs' into a file beside `output', after the line `first' (if
+ *  not null), and renames it over `output' once it is complete and synced,
+ *  so that readers of `output' only ever see the old file or the new one.
+ */
+static int writeMerged (FILE **const inputs, const int count,
+						const char *const output, const char *const first,
+						const tagLineFilter exclude, void *const data)
+{
+	char *const temporary = (char*) malloc (strlen (output) + 5);
+	FILE *out = NULL;
+	int ok = (temporary != NULL);
+	if (ok)
+	{
+		sprintf (temporary, "%s.tmp", output);
+		out = fopen (temporary, "w");
+		ok = (out != NULL);
+	}
+	if (ok  &&  first != NULL)
+		ok = (fputs (first, out) != EOF  &&  putc ('\n', out) != EOF);
+	if (ok)
+		ok = mergeStreams (inputs, count, out, exclude, data);
+	if (ok)
+		ok = syncFile (out);
+	if (out != NULL  &&  fclose (out) != 0)
+		ok = 0;
+	if (ok)
+		ok = (rename (temporary, output) == 0);
+	if (! ok  &&  out != NULL)
+		remove (temporary);
+	free (temporary);
+	return ok;
+}
+
+static tagResult sortFile (const char *const input, const char *const output,
+						   const size_t budget)
+{
+	FILE *const fp = fopen (input, "r");
+	FILE **runs = NULL;
+	int runCount = 0;
+	int declared = 0;
+	int ok = (fp != NULL);
+	if (ok)
+	{
+		ok = splitRuns (fp, budget > 0 ? budget : SORT_BUDGET,
+						&runs, &runCount, &declared);
+		fclose (fp);
+	}
+	if (ok)
+		ok = reduceRuns (&runs, &runCount);
+	if (ok)
+		ok = writeMerged (runs, runCount, output,
+						  declared ? NULL : SortedPseudoLine, NULL, NULL);
+	if (! ok)
+		perror ("tagsSortFile");
+	closeRuns (runs, runCount);
+	return ok ? TagSuccess : TagFailure;
+}
+
+static tagResult mergeFiles (const char *const *const inputs, const int count,
+							 const char *const output,
+							 const tagLineFilter exclude, void *const data)
+{
+	FILE **const streams = (FILE**) calloc ((size_t) count + 1, sizeof (FILE*));
+	int ok = (streams != NULL);
+	int opened = 0;
+	while (ok  &&  opened < count)
+	{
+		streams [opened] = fopen (inputs [opened], "r");
+		ok = (streams [opened] != NULL);
+		if (ok)
+			++opened;
+	}
+	if (ok)
+		ok = writeMerged (streams, count, output, NULL, exclude, data);
+	if (! ok)
+		perror ("tagsMergeFiles");
+	while (opened > 0)
+		fclose (streams [--opened]);
+	free (streams);
+	return ok ? TagSuccess : TagFailure;
+}
+
 /*
 *  EXTERNAL INTERFACE
 */
 
 extern tagFile *tagsOpen (const char *const filePath, tagFileInfo *const info)
 {
-	return initialize (filePath, info);
+	const tagTraceHook hook = TraceHook;
+	tagFile *result;
+	if (hook == NULL)
+		return initialize (filePath, info);
+	hook (TAG_TRACE_OPEN, 1, -1L, TraceData);
+	result = initialize (filePath, info);
+	hook (TAG_TRACE_OPEN, 0, -1L, TraceData);
+	return result;
+}
+
+extern void tagsSetTraceHook (const tagTraceHook hook, void *const data)
+{
+	TraceData = data;
+	TraceHook = hook;
 }
 
 extern tagResult tagsSetSortType (tagFile *const file, const sortType type)
@@ -725,6 +2319,47 @@ extern tagResult tagsSetSortType (tagFile *const file, const sortType type)
 	return result;
 }
 
+extern tagResult tagsSetSampleBudget (tagFile *const file, const size_t budget)
+{
+	tagResult result = TagFailure;
+	if (file != NULL  &&  file->initialized)
+	{
+		file->sample.budget = budget;
+		discardSample (file);
+		result = TagSuccess;
+	}
+	return result;
+}
+
+extern tagResult tagsPrefetch (tagFile *const file)
+{
+	tagResult result = TagFailure;
+	if (file != NULL  &&  file->initialized)
+	{
+#if defined (READTAGS_MMAP)  &&  defined (MADV_WILLNEED)
+		if (file->map != NULL)
+			madvise ((void*) file->map, file->mapSize, MADV_WILLNEED);
+#endif
+		if (file->sample.built  &&  file->sample.size != file->size)
+			discardSample (file);
+		if (file->sortMethod != TAG_UNSORTED  &&  ! file->sample.built)
+			buildSample (file);
+		result = TagSuccess;
+	}
+	return result;
+}
+
+extern tagResult tagsSetLazyFields (tagFile *const file, const int lazy)
+{
+	tagResult result = TagFailure;
+	if (file != NULL  &&  file->initialized)
+	{
+		file->fields.lazy = (short) (lazy != 0);
+		result = TagSuccess;
+	}
+	return result;
+}
+
 extern tagResult tagsFirst (tagFile *const file, tagEntry *const entry)
 {
 	tagResult result = TagFailure;
@@ -744,6 +2379,14 @@ extern tagResult tagsNext (tagFile *const file, tagEntry *const entry)
 	return result;
 }
 
+extern const char *tagsName (tagFile *const file)
+{
+	const char *result = NULL;
+	if (file != NULL  &&  file->initialized)
+		result = file->name.buffer;
+	return result;
+}
+
 extern const char *tagsField (const tagEntry *const entry, const char *const key)
 {
 	const char *result = NULL;
@@ -769,6 +2412,72 @@ extern tagResult tagsFindNext (tagFile *const file, tagEntry *const entry)
 	return result;
 }
 
+extern tagResult tagsFindAll (tagFile *const file, tagMatchSet *const set,
+							  const char *const name, const int options)
+{
+	tagResult result = TagFailure;
+	if (file != NULL  &&  file->initialized  &&  set != NULL)
+		result = findAll (file, set, name, options);
+	return result;
+}
+
+extern const char *tagsFilePath (tagFile *const file, const unsigned int id)
+{
+	const char *result = NULL;
+	if (file != NULL  &&  file->initialized  &&  id < file->paths.count)
+		result = file->paths.list [id];
+	return result;
+}
+
+extern int tagsFileId (tagFile *const file, const char *const path)
+{
+	int result = -1;
+	if (file != NULL  &&  file->initialized  &&  path != NULL  &&
+		file->paths.slotCount > 0)
+	{
+		const unsigned int slot = pathSlot (file, path);
+		if (file->paths.slots [slot] != 0)
+			result = (int) file->paths.slots [slot] - 1;
+	}
+	return result;
+}
+
+extern void tagsFreeMatchSet (tagMatchSet *const set)
+{
+	if (set != NULL)
+		freeMatchSet (set);
+}
+
+extern tagResult tagsVerifySort (tagFile *const file, tagFileInfo *const info)
+{
+	tagResult result = TagFailure;
+	if (file != NULL  &&  file->initialized)
+	{
+		verifySort (file, info);
+		result = TagSuccess;
+	}
+	return result;
+}
+
+extern tagResult tagsSortFile (const char *const input, const char *const output,
+							   const size_t budget)
+{
+	tagResult result = TagFailure;
+	if (input != NULL  &&  output != NULL)
+		result = sortFile (input, output, budget);
+	return result;
+}
+
+extern tagResult tagsMergeFiles (const char *const *const inputs, const int count,
+								 const char *const output,
+								 const tagLineFilter exclude, void *const data)
+{
+	tagResult result = TagFailure;
+	if (inputs != NULL  &&  count > 0  &&  output != NULL)
+		result = mergeFiles (inputs, count, output, exclude, data);
+	return result;
+}
+
 extern tagResult tagsClose (tagFile *const file)
 {
 	tagResult result = TagFailure;
@@ -786,9 +2495,13 @@ extern tagResult tagsClose (tagFile *const file)
 
 #ifdef READTAGS_MAIN
 
+#include <time.h>
+
 static const char *TagFileName = "tags";
 static const char *ProgramName;
 static int extensionFields;
+static int LazyFields;
+static size_t SortBudget;
 static int SortOverride;
 static sortType SortMethod;
 
@@ -804,6 +2517,7 @@ static void printTag (const tagEntry *entry)
 		entry->name, entry->file, entry->address.pattern);
 	if (extensionFields)
 	{
+		tagsField (entry, "kind");
 		if (entry->kind != NULL  &&  entry->kind [0] != '\0')
 			printf ("%s\tkind:%s", sep, entry->kind);
 		if (entry->fileScope)
@@ -835,6 +2549,7 @@ static void findTag (const char *const name, const int options)
 	{
 		if (SortOverride)
 			tagsSetSortType (file, SortMethod);
+		tagsSetLazyFields (file, LazyFields);
 		if (tagsFind (file, &entry, name, options) == TagSuccess)
 		{
 			do
@@ -859,22 +2574,130 @@ static void listTags (void)
 	}
 	else
 	{
+		tagsSetLazyFields (file, LazyFields);
 		while (tagsNext (file, &entry) == TagSuccess)
 			printTag (&entry);
 		tagsClose (file);
 	}
 }
 
+static void verifyTags (void)
+{
+	static const char *const orders [] = { "unsorted", "sorted", "foldcase" };
+	tagFileInfo info;
+	tagFile *const file = tagsOpen (TagFileName, &info);
+	if (file == NULL)
+	{
+		fprintf (stderr, "%s: cannot open tag file: %s: %s\n",
+				ProgramName, strerror (info.status.error_number), TagFileName);
+		exit (1);
+	}
+	else
+	{
+		tagsVerifySort (file, &info);
+		printf ("declared: %s\nactual: %s\n",
+				orders [info.file.sort % 3], orders [info.file.actualSort % 3]);
+		tagsClose (file);
+	}
+}
+
+static void sortTags (const char *const output)
+{
+	if (tagsSortFile (TagFileName, output, SortBudget) != TagSuccess)
+	{
+		fprintf (stderr, "%s: cannot sort tag file: %s\n",
+				ProgramName, TagFileName);
+		exit (1);
+	}
+}
+
+/*  Full scans of the tag file per second, in MB, using `scanner'. Entries are
+ *  parsed if `parse' is set, with their extension fields deferred if it is 2.
+ */
+static double scanThroughput (const lineScanner scanner, const int parse)
+{
+	tagFileInfo info;
+	tagEntry entry;
+	double bytes = 0.0;
+	double seconds;
+	int passes = 0;
+	const clock_t start = clock ();
+	LineScanner = scanner;
+	do
+	{
+		tagFile *const file = tagsOpen (TagFileName, &info);
+		if (file == NULL)
+		{
+			fprintf (stderr, "%s: cannot open tag file: %s: %s\n",
+					ProgramName, strerror (info.status.error_number), TagFileName);
+			exit (1);
+		}
+		tagsSetLazyFields (file, parse == 2);
+		while (tagsNext (file, parse ? &entry : NULL) == TagSuccess)
+			;
+		bytes += (double) file->size;
+		tagsClose (file);
+		++passes;
+		seconds = (double) (clock () - start) / CLOCKS_PER_SEC;
+	} while (passes < 3  ||  seconds < 1.0);
+	return bytes / seconds / (1024.0 * 1024.0);
+}
+
+static void benchmarkScanners (void)
+{
+	static const struct {
+		const char *name;
+		lineScanner scanner;
+		const char *feature;
+	} scanners [] = {
+		{ "strchr", scanLineBaseline, NULL },
+		{ "scalar", scanLineScalar, NULL },
+#ifdef READTAGS_SIMD
+		{ "sse2",   scanLineSSE2,   "sse2" },
+		{ "avx2",   scanLineAVX2,   "avx2" },
+#endif
+	};
+	size_t i;
+	printf ("%-8s %12s %12s %12s\n",
+			"scanner", "scan MB/s", "parse MB/s", "lazy MB/s");
+	for (i = 0  ;  i < sizeof (scanners) / sizeof (scanners [0])  ;  ++i)
+	{
+		int supported = 1;
+#ifdef READTAGS_SIMD
+		__builtin_cpu_init ();
+		if (scanners [i].feature != NULL)
+			supported = (strcmp (scanners [i].feature, "avx2") == 0) ?
+				__builtin_cpu_supports ("avx2") : __builtin_cpu_supports ("sse2");
+#endif
+		if (supported)
+		{
+			const double scan = scanThroughput (scanners [i].scanner, 0);
+			const double parse = scanThroughput (scanners [i].scanner, 1);
+			const double lazy = scanThroughput (scanners [i].scanner, 2);
+			printf ("%-8s %12.1f %12.1f %12.1f\n",
+					scanners [i].name, scan, parse, lazy);
+		}
+	}
+	LineScanner = NULL;
+	selectLineScanner ();
+}
+
 const char *const Usage =
 	"Find tag file entries matching specified names.\n\n"
-	"Usage: %s [-ilp] [-s[0|1]] [-t file] [name(s)]\n\n"
+	"Usage: %s [-eilLpV] [-s[0|1]] [-t file] [-m bytes] [-S file] [name(s)]\n\n"
 	"Options:\n"
+	"    -B           Benchmark full scans of the tag file with each line scanner,\n"
+	"                 against the strchr () parsing they replaced.\n"
 	"    -e           Include extension fields in output.\n"
 	"    -i           Perform case-insensitive matching.\n"
 	"    -l           List all tags.\n"
+	"    -L           Defer parsing of extension fields until they are printed.\n"
+	"    -m bytes     Memory for each sorted run of -S (default: 16 MB).\n"
 	"    -p           Perform partial matching.\n"
 	"    -s[0|1|2]    Override sort detection of tag file.\n"
+	"    -S file      Write a copy of the tag file sorted in C locale order.\n"
 	"    -t file      Use specified tag file (default: \"tags\").\n"
+	"    -V           Verify the sort order of the tag file.\n"
 	"Note that options are acted upon as encountered, so order is significant.\n";
 
 extern int main (int argc, char **argv)
@@ -907,7 +2730,9 @@ extern int main (int argc, char **argv)
 					case 'i': options |= TAG_IGNORECASE;   break;
 					case 'p': options |= TAG_PARTIALMATCH; break;
 					case 'l': listTags (); actionSupplied = 1; break;
-			
+					case 'L': LazyFields = 1;              break;
+					case 'V': verifyTags (); actionSupplied = 1; break;
+					case 'B': benchmarkScanners (); actionSupplied = 1; break;
 					case 't':
 						if (arg [j+1] != '\0')
 						{
@@ -922,6 +2747,29 @@ extern int main (int argc, char **argv)
 							exit (1);
 						}
 						break;
+					case 'm':
+					case 'S':
+					{
+						const char *value = NULL;
+						if (arg [j+1] != '\0')
+							value = arg + j + 1;
+						else if (i + 1 < argc)
+							value = argv [++i];
+						else
+						{
+							fprintf (stderr, Usage, ProgramName);
+							exit (1);
+						}
+						if (arg [j] == 'm')
+							SortBudget = (size_t) atol (value);
+						else
+						{
+							sortTags (value);
+							actionSupplied = 1;
+						}
+						j += strlen (arg + j) - 1;
+						break;
+					}
 					case 's':
 						SortOverride = 1;
 						++j;
@@ -21,6 +21,8 @@
 #ifndef READTAGS_H
 #define READTAGS_H
 
+#include <stddef.h>  /* to declare size_t */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -69,6 +71,13 @@ typedef struct {
 
 				/* how is the tag file sorted? */
 			sortType sort;
+
+				/* has the order of the tags been checked by tagsVerifySort()? */
+			short verified;
+
+				/* order tagsVerifySort() found, which lookups use from then on
+				 * (TAG_UNSORTED until verified) */
+			sortType actualSort;
 	} file;
 
 
@@ -137,8 +146,72 @@ typedef struct {
 		tagExtensionField *list;
 	} fields;
 
+		/* used by tagsField (); not to be changed by the caller */
+	struct {
+			/* tag file the entry was read from */
+		tagFile *file;
+
+			/* extension fields not yet parsed (see tagsSetLazyFields()) */
+		char *fields;
+	} pending;
+
 } tagEntry;
 
+/* A tag found by tagsFindAll(). */
+typedef struct {
+
+		/* name of tag */
+	const char *name;
+
+		/* path of source file containing definition of tag, which belongs
+		 * to the tag file and stays valid until it is closed */
+	const char *file;
+
+		/* number of the source file within the tag file, shared by all
+		 * matches in it (see tagsFilePath()) */
+	unsigned int fileId;
+
+		/* line number in source file of tag definition
+		 * (may be zero if not known) */
+	unsigned long lineNumber;
+
+} tagMatch;
+
+struct sTagArena;
+
+/* Decides whether a line read from input number `input' is left out of the
+ * output of tagsMergeFiles(); returns non-zero to leave it out. */
+typedef int (*tagLineFilter) (const char *const line, const int input, void *const data);
+
+/* Operations reported to a trace hook (see tagsSetTraceHook()). */
+typedef enum {
+	TAG_TRACE_OPEN,     /* tagsOpen() */
+	TAG_TRACE_SEARCH,   /* a binary search of a sorted tag file */
+	TAG_TRACE_PROBE     /* one line read by a binary search */
+} tagTraceEvent;
+
+/* Called as a traced operation starts, with `begin' non-zero, and as it
+ * ends. `position' is the offset probed, or -1 for the other operations. */
+typedef void (*tagTraceHook) (const tagTraceEvent event, const int begin, const long position, void *const data);
+
+/* The tags found by tagsFindAll(). The names of the tags are kept in an arena
+ * owned by the set, so they stay valid until the set is next filled or freed. */
+typedef struct {
+
+		/* number of entries in `list' */
+	size_t count;
+
+		/* tags found, in the order tagsFindNext() would return them */
+	tagMatch *list;
+
+		/* number of entries allocated for `list' */
+	size_t max;
+
+		/* storage for the strings of `list' */
+	struct sTagArena *arena;
+
+} tagMatchSet;
+
 
 /*
 *  FUNCTION PROTOTYPES
@@ -153,7 +226,9 @@ typedef struct {
 *  tag file, and info.status.opened will be set to true. If unsuccessful,
 *  info.status.opened will be set to false and info.status.error_number will
 *  be set to the errno value representing the system error preventing the tag
-*  file from being successfully opened.
+*  file from being successfully opened. Where the platform supports it the tag
+*  file is memory mapped, otherwise it is read through stdio; lookups return
+*  the same results either way.
 */
 extern tagFile *tagsOpen (const char *const filePath, tagFileInfo *const info);
 
@@ -172,6 +247,38 @@ extern tagFile *tagsOpen (const char *const filePath, tagFileInfo *const info);
 */
 extern tagResult tagsSetSortType (tagFile *const file, const sortType type);
 
+/*
+*  Sets the amount of memory, in bytes, which may be used to keep a sample of
+*  the lines of a sorted tag file in memory. The sample is built on the first
+*  binary search and lets later searches find the neighbourhood of a name
+*  without reading the file, so that only a small window of the file is read
+*  per lookup. It is rebuilt if the size of the tag file changes. A budget of
+*  zero disables sampling. The function will return TagSuccess if called on an
+*  open tag file or TagFailure if not.
+*/
+extern tagResult tagsSetSampleBudget (tagFile *const file, const size_t budget);
+
+/*
+*  Prepares an open tag file for the lookups to come: asks for the whole of a
+*  memory mapped file to be read ahead and, if the file is sorted, builds the
+*  sample used by binary searches, which is otherwise built by the first one.
+*  As it moves the read position, it must not be called between tagsFind()
+*  and tagsFindNext(). The function will return TagSuccess if called on an
+*  open tag file or TagFailure if not.
+*/
+extern tagResult tagsPrefetch (tagFile *const file);
+
+/*
+*  Defers parsing of the extension fields of each entry read until tagsField()
+*  is first called for it, which saves the parsing for entries of which only
+*  the name, file and address are used. While deferred, the `kind',
+*  `fileScope' and `fields' members of an entry, and a line number given by a
+*  "line" field, are only filled in by that first call to tagsField(). The
+*  function will return TagSuccess if called on an open tag file or
+*  TagFailure if not.
+*/
+extern tagResult tagsSetLazyFields (tagFile *const file, const int lazy);
+
 /*
 *  Reads the first tag in the file, if any. It is passed the handle to an
 *  opened tag file and a (possibly null) pointer to a structure which, if not
@@ -191,12 +298,23 @@ extern tagResult tagsFirst (tagFile *const file, tagEntry *const entry);
 */
 extern tagResult tagsNext (tagFile *const file, tagEntry *const entry);
 
+/*
+*  Returns the name of the tag most recently read by tagsFirst(), tagsNext(),
+*  tagsFind() or tagsFindNext(). This is available even when those functions
+*  were passed a null entry, in which case the rest of the line is not parsed,
+*  which makes it the cheapest way to walk all of the names in a tag file. The
+*  string is overwritten by the next read from the same tag file.
+*/
+extern const char *tagsName (tagFile *const file);
+
 /*
 *  Retrieve the value associated with the extension field for a specified key.
 *  It is passed a pointer to a structure already populated with values by a
 *  previous call to tagsNext(), tagsFind(), or tagsFindNext(), and a string
 *  containing the key of the desired extension field. If no such field of the
-*  specified key exists, the function will return null.
+*  specified key exists, the function will return null. The "line" field may
+*  be retrieved as well, even though it is also given by the address of the
+*  entry. Fields are looked up by a hash of their keys.
 */
 extern const char *tagsField (const tagEntry *const entry, const char *const key);
 
@@ -215,8 +333,10 @@ extern const char *tagsField (const tagEntry *const entry, const char *const key
 *        Only tags whose full lengths match `name' will qualify.
 *
 *    TAG_IGNORECASE
-*        Matching will be performed in a case-insenstive manner. Note that
-*        this disables binary searches of the tag file.
+*        Matching will be performed in a case-insenstive manner. Unless the
+*        tag file is sorted with case folded, the first such search reads
+*        the whole file to build an index of the tags ordered by folded
+*        name, which later case-insenstive searches binary search instead.
 *
 *    TAG_OBSERVECASE
 *        Matching will be performed in a case-senstive manner. Note that
@@ -236,6 +356,82 @@ extern tagResult tagsFind (tagFile *const file, tagEntry *const entry, const cha
 */
 extern tagResult tagsFindNext (tagFile *const file, tagEntry *const entry);
 
+/*
+*  Finds all tags matching `name' in a single pass, as tagsFind() followed by
+*  tagsFindNext() would, and stores them in `set', replacing whatever it held.
+*  The names of the matches are copied into storage belonging to the set, and
+*  the storage and `list' are reused from one call to the next, so a set kept
+*  for repeated searches stops allocating once it has grown to fit. Source
+*  files are numbered by the tag file, which stores each path once no matter
+*  how many lookups find tags in it. The set must be zeroed before
+*  its first use and released with tagsFreeMatchSet(). The function will
+*  return TagSuccess if any tag was found, or TagFailure if not.
+*/
+extern tagResult tagsFindAll (tagFile *const file, tagMatchSet *const set, const char *const name, const int options);
+
+/*
+*  Returns the path of the source file numbered `id' by tagsFindAll(), or null
+*  if no file has that number. Numbers are only valid for the tag file handle
+*  they came from, and are not reused while it stays open.
+*/
+extern const char *tagsFilePath (tagFile *const file, const unsigned int id);
+
+/*
+*  Returns the number tagsFindAll() has given the source file `path', or -1
+*  if no tag found so far is in that file. Comparing the number against the
+*  `fileId' of matches then tells which are in the file.
+*/
+extern int tagsFileId (tagFile *const file, const char *const path);
+
+/*
+*  Frees the storage of a set filled by tagsFindAll(), leaving it empty.
+*/
+extern void tagsFreeMatchSet (tagMatchSet *const set);
+
+/*
+*  Reads through the tag file once to check whether the names really are in
+*  the order the !_TAG_FILE_SORTED pseudo-tag declares, and from then on
+*  searches the file according to the order found. The declared and actual
+*  orders are stored in `info' (if not null), in `file.sort' and
+*  `file.actualSort'. A file in neither order should be sorted with
+*  tagsSortFile(). The function will return TagSuccess if called on an open
+*  tag file or TagFailure if not.
+*/
+extern tagResult tagsVerifySort (tagFile *const file, tagFileInfo *const info);
+
+/*
+*  Writes a copy of the tag file `input' to `output' with its lines sorted in
+*  C locale byte order, as "LC_ALL=C sort" would, and the !_TAG_FILE_SORTED
+*  pseudo-tag set to 1. Lines are sorted in runs of at most about `budget'
+*  bytes (a default is used if zero) held in memory at a time, which are then
+*  merged through temporary files. The copy is written beside `output' and
+*  renamed over it once complete, so `output' may be the same as `input'. The
+*  function will return TagSuccess if the copy was written, or TagFailure if
+*  not.
+*/
+extern tagResult tagsSortFile (const char *const input, const char *const output, const size_t budget);
+
+/*
+*  Merges the tag files `inputs', each sorted in C locale byte order, into
+*  `output' in one streaming pass, keeping that order. Each line is passed to
+*  `exclude' (if not null) along with the number of its input, and left out
+*  if it returns non-zero, so stale lines of one input can be dropped while
+*  their replacements are taken from another. Equal lines are written in the
+*  order of their inputs. The output is written beside `output' and renamed
+*  over it once complete, so `output' may be one of the inputs. The function
+*  will return TagSuccess if the output was written, or TagFailure if not.
+*/
+extern tagResult tagsMergeFiles (const char *const *const inputs, const int count, const char *const output, const tagLineFilter exclude, void *const data);
+
+/*
+*  Installs `hook' to be called, with `data', around the operations listed by
+*  tagTraceEvent, in every tag file and on whichever thread runs them, or
+*  removes the hook if it is null. Without a hook the cost of tracing is one
+*  test per operation. The hook is read without locking, so it must be set
+*  before any other thread uses the library.
+*/
+extern void tagsSetTraceHook (const tagTraceHook hook, void *const data);
+
 /*
 *  Call tagsTerminate() at completion of reading the tag file, which will
 *  close the file and free any internal memory allocated. The function will